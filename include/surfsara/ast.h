@@ -33,6 +33,9 @@ SOFTWARE.
 #include <map>
 #include <functional>
 #include <type_traits>
+#include <iterator>
+#include <memory>
+#include "impl/arena.hpp"
 
 namespace surfsara
 {
@@ -42,6 +45,64 @@ namespace surfsara
     {
       template<typename TARGET>
       struct Converter;
+
+      template<typename BASE, typename PROJECTION>
+      class ObjectIterator;
+
+      template<typename ITERATOR>
+      class Range;
+
+      template<typename T>
+      class Span;
+
+      template<typename ENTRY>
+      struct PairProjection;
+
+      template<typename ENTRY>
+      struct KeyProjection;
+
+      template<typename ENTRY>
+      struct ValueProjection;
+
+      inline std::size_t hashCombine(std::size_t seed, std::size_t value);
+
+      template<typename T>
+      struct Payload;
+
+      class Deduplicator;
+
+      struct BorrowedString;
+
+      struct RawNumber;
+
+      struct Deferred;
+
+      struct IdentityHash
+      {
+        std::size_t operator()(std::size_t h) const { return h; }
+      };
+
+      struct KeyPayload;
+
+      /**
+       * position of an object member in insertion order with the
+       * hash of its key, ordered by the position only
+       */
+      struct MemberPosition
+      {
+        MemberPosition(std::size_t _index, std::size_t _keyHash = 0)
+          : index(_index), keyHash(_keyHash) {}
+        std::size_t index;
+        std::size_t keyHash;
+      };
+
+      struct MemberPositionLess
+      {
+        bool operator()(const MemberPosition & lhs, const MemberPosition & rhs) const
+        {
+          return lhs.index < rhs.index;
+        }
+      };
     }
 
     class Node;
@@ -52,6 +113,57 @@ namespace surfsara
     typedef char Char;
     typedef double Float;
 
+    /**
+     * statistics of the payload pool of String, Array or Object,
+     * see poolStatistics()
+     */
+    struct PoolStatistics
+    {
+      // size of a pool block in bytes
+      std::size_t blockSize;
+
+      // blocks handed out and returned by the calling thread
+      std::size_t allocations;
+      std::size_t deallocations;
+
+      // free blocks in the list of the calling thread
+      std::size_t cached;
+
+      // free blocks left by finished threads
+      std::size_t orphaned;
+
+      // process wide
+      std::size_t slabs;
+      std::size_t bytesReserved;
+    };
+
+    /**
+     * String, Array and Object payloads created within a
+     * PayloadPoolScope are recycled through thread local free
+     * lists, T is one of these types
+     */
+    template<typename T>
+    inline PoolStatistics poolStatistics();
+
+    /**
+     * While an instance exists, the payloads created by the calling
+     * thread are taken from thread local free lists instead of the
+     * global allocator, which suits workloads that create and drop
+     * many small values. Memory that went to the free lists stays
+     * there for the rest of the process. Scopes nest, payloads
+     * created outside of them are returned to the global allocator.
+     */
+    class PayloadPoolScope
+    {
+    public:
+      inline explicit PayloadPoolScope(bool enable = true);
+      inline ~PayloadPoolScope();
+      PayloadPoolScope(const PayloadPoolScope &) = delete;
+      PayloadPoolScope & operator=(const PayloadPoolScope &) = delete;
+    private:
+      bool enabled;
+    };
+
     class PathError : public std::exception
     {
     public:
@@ -84,24 +196,128 @@ namespace surfsara
     {
     public:
       typedef Node value_type;
-      typedef std::vector<value_type>::iterator iterator;
+      typedef std::vector<value_type, details::Allocator<value_type>> storage_type;
+      typedef storage_type::iterator iterator;
+      typedef storage_type::const_iterator const_iterator;
+      typedef storage_type::reverse_iterator reverse_iterator;
+      typedef storage_type::const_reverse_iterator const_reverse_iterator;
+      typedef details::Span<Node> Span;
+      typedef details::Span<const Node> ConstSpan;
 
       Array();
       Array(const std::initializer_list<Node> & l);
+
+      /**
+       * empty array whose element storage is taken from the arena
+       */
+      explicit Array(details::Arena & arena);
       inline void forEach(std::function<void(Node & node)> lambda);
       inline void forEach(std::function<void(const Node & node)> lambda)const;
       inline std::size_t size() const;
+      inline bool empty() const;
+      inline std::size_t capacity() const;
+
+      /**
+       * reserve storage for at least n elements
+       */
+      inline void reserve(std::size_t n);
+
+      /**
+       * release unused capacity
+       */
+      inline void shrinkToFit();
       inline void pushBack(const Node & node);
+      inline void pushBack(Node && node);
       inline void insert(iterator itr, Node value);
       inline void remove(std::size_t i);
       
+      /**
+       * element wise comparison
+       */
       inline bool operator==(const Array & rhs) const;
+      inline bool operator!=(const Array & rhs) const { return !operator==(rhs); }
+
+      /**
+       * structural hash, computed on each call unless it was
+       * cached by cacheHash()
+       */
+      inline std::size_t hash() const;
+
+      /**
+       * compute hash() and keep it until the array is modified
+       * through a non-const member. References into the array
+       * taken before the call must not be used to modify it.
+       */
+      inline std::size_t cacheHash() const;
+
+      /**
+       * random access iterators over the elements
+       */
+      inline iterator begin();
       inline iterator end();
+      inline const_iterator begin() const;
+      inline const_iterator end() const;
+      inline const_iterator cbegin() const;
+      inline const_iterator cend() const;
+      inline reverse_iterator rbegin();
+      inline reverse_iterator rend();
+      inline const_reverse_iterator rbegin() const;
+      inline const_reverse_iterator rend() const;
+
+
+      /**
+       * bounds checked element access, throws std::out_of_range
+       */
       inline Node & operator[](std::size_t i);
       inline const Node & operator[](std::size_t i) const;
+
+      /**
+       * element access without bounds check, i must be smaller than size()
+       */
+      inline Node & unsafeAt(std::size_t i);
+      inline const Node & unsafeAt(std::size_t i) const;
+
+      /**
+       * pointer to the contiguous element storage,
+       * invalidated by any operation that changes the size
+       */
+      inline Node * data();
+      inline const Node * data() const;
+
+      /**
+       * contiguous view on the elements with unchecked access
+       */
+      inline Span span();
+      inline ConstSpan span() const;
+
       inline void swap(Array & rhs);
     private:
-      std::vector<Node> data;
+      storage_type elements;
+      mutable std::size_t hashValue;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    //
+    // Key
+    //
+    ////////////////////////////////////////////////////////////////////////////
+
+    /**
+     * object key with its precomputed hash. Copies share one immutable
+     * payload, keys from StringPool::key() share the pooled payload.
+     * Object::set() copies the text into the member.
+     */
+    class Key
+    {
+    public:
+      inline explicit Key(const String & text);
+      inline explicit Key(std::shared_ptr<const details::KeyPayload> payload);
+      inline const String & str() const;
+      inline std::size_t hash() const;
+      inline bool operator==(const Key & rhs) const;
+      inline bool operator!=(const Key & rhs) const { return !operator==(rhs); }
+    private:
+      std::shared_ptr<const details::KeyPayload> payload;
     };
 
     ////////////////////////////////////////////////////////////////////////////
@@ -112,16 +328,59 @@ namespace surfsara
     class Object
     {
     public:
-      typedef std::pair<String, Node> value_type;
-      typedef std::map<std::size_t, std::pair<String, Node>>::iterator iterator;
-      
+      typedef std::pair<const String, Node> value_type;
+      // members keep the hash of their key next to the position
+      typedef std::map<details::MemberPosition, value_type, details::MemberPositionLess,
+                       details::Allocator<std::pair<const details::MemberPosition, value_type>>> storage_type;
+      // key hash -> position in data, keys are only stored in data
+      typedef std::unordered_multimap<std::size_t, std::size_t, details::IdentityHash, std::equal_to<std::size_t>,
+                                      details::Allocator<std::pair<const std::size_t, std::size_t>>> lookup_type;
+
+      /**
+       * Bidirectional iterators in insertion order,
+       * the key of a dereferenced pair is const.
+       */
+      typedef details::ObjectIterator<storage_type::iterator,
+                                      details::PairProjection<storage_type::value_type>> iterator;
+      typedef details::ObjectIterator<storage_type::const_iterator,
+                                      details::PairProjection<const storage_type::value_type>> const_iterator;
+      typedef details::Range<details::ObjectIterator<storage_type::const_iterator,
+                                                     details::KeyProjection<const storage_type::value_type>>> KeyView;
+      typedef details::Range<details::ObjectIterator<storage_type::iterator,
+                                                     details::ValueProjection<storage_type::value_type>>> ValueView;
+      typedef details::Range<details::ObjectIterator<storage_type::const_iterator,
+                                                     details::ValueProjection<const storage_type::value_type>>> ConstValueView;
+
       Object();
       Object(const std::initializer_list<std::pair<String, Node>> & l);
+
+      /**
+       * empty object whose storage is taken from the arena
+       */
+      explicit Object(details::Arena & arena);
       inline bool empty() const;
       inline bool set(const String & k, const Node & node);
       inline bool set(const String & k, Node && node);
       inline bool has(const String & v) const;
       inline Node get(const String & k) const;
+
+      /**
+       * hash of a key in the key index, the overloads below take
+       * a precomputed hash and skip hashing the key again
+       */
+      inline static std::size_t hashKey(const String & k);
+      inline bool set(const String & k, std::size_t keyHash, const Node & node);
+      inline bool set(const String & k, std::size_t keyHash, Node && node);
+      inline bool has(const String & k, std::size_t keyHash) const;
+      inline Node get(const String & k, std::size_t keyHash) const;
+
+      /**
+       * lookups with the hash carried by the key, see StringPool::key()
+       */
+      inline bool set(const Key & k, const Node & node);
+      inline bool set(const Key & k, Node && node);
+      inline bool has(const Key & k) const;
+      inline Node get(const Key & k) const;
       inline Node & operator[](const String & k);
       inline const Node & operator[](const String & k) const;
 
@@ -147,6 +406,14 @@ namespace surfsara
       inline Node values() const;
       inline Node keys() const;
 
+      /**
+       * lazy views on the keys and values in insertion order,
+       * in contrast to keys() and values() nothing is copied
+       */
+      inline KeyView keyView() const;
+      inline ValueView valueView();
+      inline ConstValueView valueView() const;
+
       inline std::size_t size() const;
       /**
        * Remove the key if exists
@@ -160,18 +427,49 @@ namespace surfsara
        */
       inline std::size_t remove(std::function<bool(const String &, const Node & n)> predicate);
 
-      inline bool operator==(const Object & rhs)const{ return this == &rhs; }
+      /**
+       * two objects are equal if they have equal members in the same order
+       */
+      inline bool operator==(const Object & rhs) const;
+      inline bool operator!=(const Object & rhs) const { return !operator==(rhs); }
 
-      /*@todo use fusion adapter */
+      /**
+       * structural hash, computed on each call unless it was
+       * cached by cacheHash()
+       */
+      inline std::size_t hash() const;
+
+      /**
+       * compute hash() and keep it until the object is modified
+       * through a non-const member. References into the object
+       * taken before the call must not be used to modify it.
+       */
+      inline std::size_t cacheHash() const;
+
+      inline iterator begin();
       inline iterator end();
+      inline const_iterator begin() const;
+      inline const_iterator end() const;
+      inline const_iterator cbegin() const;
+      inline const_iterator cend() const;
       inline void insert(iterator itr, const std::pair<String, Node> & value);
 
+      /**
+       * release unused buckets of the key index
+       */
+      inline void shrinkToFit();
+
       inline void swap(Object & rhs);
     private:
       template<typename T>
-      inline bool setInternal(const String & k, T node);
-      std::map<std::size_t, std::pair<String, Node>> data;
-      std::unordered_map<String, std::size_t> lookup;
+      inline bool setInternal(const String & k, std::size_t h, T node);
+      inline lookup_type::iterator findEntry(const String & k, std::size_t h);
+      inline storage_type::iterator locate(const String & k, std::size_t h);
+      inline storage_type::const_iterator locate(const String & k, std::size_t h) const;
+      inline void eraseEntry(storage_type::const_iterator itr);
+      storage_type data;
+      lookup_type lookup;
+      mutable std::size_t hashValue;
     };
 
     ////////////////////////////////////////////////////////////////////////////
@@ -208,9 +506,20 @@ namespace surfsara
       template<typename T>
       T& as();
 
+      /**
+       * deep structural comparison
+       */
       inline bool operator==(const Node & rhs) const;
       inline bool operator!=(const Node & rhs) const;
 
+      /**
+       * structural hash, equal nodes have equal hashes.
+       * Only the hashes of shared payloads (see dedupe()) and the
+       * hashes computed with ParseOptions::hash are cached, the
+       * others are computed on each call.
+       */
+      inline std::size_t hash() const;
+
       inline Node find(const std::string & path) const;
       inline Node find(const std::string & path,
                        const std::function<bool(const Node & root,
@@ -261,6 +570,54 @@ namespace surfsara
                          const std::function<bool(const Node & root,
                                                   const std::vector<std::string> & path)> & pred);
       
+      /**
+       * Share one immutable payload between all equal strings, arrays and
+       * objects in the tree. Shared payloads are copied on the first
+       * non-const access (copy on write), copying a node that holds a
+       * shared payload is O(1).
+       * References into the tree are invalidated.
+       */
+      inline void dedupe();
+
+      /**
+       * true if the payload of the node is shared, see dedupe()
+       */
+      inline bool isShared() const;
+
+      /**
+       * Release the unused capacity of all strings, arrays and object
+       * indexes in the tree. Shared payloads are immutable and skipped.
+       */
+      inline void compact();
+
+      /**
+       * true if the node is materialized on first access,
+       * see ParseOptions::borrow, ParseOptions::lazyNumbers
+       * and ParseOptions::deferDepth
+       */
+      inline bool isLazy() const;
+
+      /**
+       * source text of a number parsed with ParseOptions::lazyNumbers,
+       * nullptr for all other nodes
+       */
+      inline const String * numberText() const;
+
+      /**
+       * source text of an array or object deferred by
+       * ParseOptions::deferDepth or deferKeys, nullptr for all
+       * other nodes
+       */
+      inline const String * deferredText() const;
+
+      /**
+       * characters of a string, false for all other nodes. Unlike
+       * as<String>(), which copies a string parsed with
+       * ParseOptions::borrow into the node on first access, this
+       * reads a borrowed string from the input.
+       */
+      inline bool stringData(const char *& data, std::size_t & size) const;
+
       template<typename Visitor> 
       void applyVisitor(Visitor & visitor) const;
 
@@ -278,9 +635,12 @@ namespace surfsara
           Boolean booleanValue;
           Integer integerValue;
           Float floatValue;
-          String * stringValue;
-          Array * arrayValue;
-          Object * objectValue;
+          details::Payload<String> * stringValue;
+          details::Payload<Array> * arrayValue;
+          details::Payload<Object> * objectValue;
+          details::Payload<details::BorrowedString> * borrowedValue;
+          details::Payload<details::RawNumber> * rawNumber;
+          details::Payload<details::Deferred> * deferredValue;
         } v;
         std::type_index typeIndex;
 
@@ -294,14 +654,56 @@ namespace surfsara
         Value(Array && a);
         Value(const Object & o);
         Value(Object && o);
+        explicit Value(details::Payload<String> * s);
+        explicit Value(details::Payload<Array> * a);
+        explicit Value(details::Payload<Object> * o);
+        explicit Value(details::Payload<details::BorrowedString> * s);
+        explicit Value(details::Payload<details::RawNumber> * n);
+        explicit Value(details::Payload<details::Deferred> * d);
         Value(const Value & rhs);
-        Value(Value && rhs);
+        Value(Value && rhs) noexcept;
         inline Value & operator=(const Value & rhs);
+        inline Value & operator=(Value && rhs) noexcept;
         ~Value();
 
         template<typename T>
         inline bool isA() const;
 
+        inline bool operator==(const Value & rhs) const;
+        inline std::size_t hash() const;
+
+        /**
+         * true if the payload is shared with other values,
+         * see Node::dedupe()
+         */
+        inline bool isShared() const;
+        inline bool stringData(const char *& data, std::size_t & size) const;
+
+        /**
+         * drop the arena registration of a complete payload, made at
+         * position slot, if destroying it would not release anything
+         * outside the arena
+         */
+        inline void dismissCleanup(details::Arena & arena, std::size_t slot) const;
+
+        /**
+         * mark the string, array or object payload as shared,
+         * it is copied on the first non-const access
+         */
+        inline void share();
+
+        /**
+         * take a reference on the shared payload of rhs, unlike
+         * operator= this does not copy payloads that live in an arena
+         */
+        inline void shareFrom(const Value & rhs);
+
+        /**
+         * true if the value is a placeholder that is converted on access,
+         * e.g. a string referencing the parser input
+         */
+        inline bool isLazy() const;
+
         template<typename T>
         T& as();
 
@@ -309,11 +711,20 @@ namespace surfsara
         const T& as() const;
 
       private:
+        // the lazy number behind the value, nullptr otherwise
+        inline const details::RawNumber * rawNumber() const;
         inline void init(const Value & rhs);
         inline void cleanup();
+        inline static void reclaim(Value & value, std::vector<Value> & work);
       };
 
       Node(const Value & v);
+      Node(Value && v);
+
+      /**
+       * move the value out of the node, the node becomes null
+       */
+      inline Value release();
     private:
       typedef std::function<bool(const Node & root,
                                  const std::vector<std::string> & path)> Predicate;
@@ -392,6 +803,8 @@ namespace surfsara
                                    UpdateWorkspace & ws,
                                    std::size_t pos,
                                    bool ignoreUndef);
+
+      inline void dedupeImpl(details::Deduplicator & deduplicator);
       
       Value value;
     };
@@ -406,6 +819,7 @@ namespace surfsara
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include "impl/pool.hpp"
 #include "impl/object.hpp"
 #include "impl/array.hpp"
 #include "impl/node.hpp"
@@ -0,0 +1,77 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+#include "ast.h"
+#include "json_parser.h"
+#include <memory>
+#include <string>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    /**
+     * Owns a parsed tree whose strings, arrays and objects are
+     * allocated in an arena. The tree is read-only, destroying
+     * the document releases the arena in one pass without
+     * walking the tree. Only nodes that own memory outside the
+     * arena are destroyed one by one: strings and keys too long
+     * to be stored in place, borrowed strings and deferred
+     * subtrees. Copying a node out of the document yields an
+     * independent heap copy.
+     */
+    class Document
+    {
+    public:
+      Document();
+      Document(Document && rhs);
+      Document & operator=(Document && rhs);
+      Document(const Document &) = delete;
+      Document & operator=(const Document &) = delete;
+
+      inline const Node & root() const;
+
+      /**
+       * replace the content of the document by the parsed input
+       */
+      inline void parse(const std::string & str, const ParseOptions & options = ParseOptions());
+      inline void parse(const char * str, std::size_t n, const ParseOptions & options = ParseOptions());
+
+      /**
+       * memory reserved by the arena in bytes
+       */
+      inline std::size_t bytesAllocated() const;
+
+    private:
+      // declared before the root, the root is destroyed first
+      std::unique_ptr<details::Arena> arena;
+      Node rootNode;
+    };
+
+    inline Document parseDocument(const std::string & str);
+    inline Document parseDocument(const std::string & str, const ParseOptions & options);
+  }
+}
+
+#include "impl/document.hpp"
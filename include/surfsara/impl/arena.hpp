@@ -0,0 +1,260 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <type_traits>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace details
+    {
+      /**
+       * Bump pointer allocator. Memory is only released when the
+       * arena is destroyed, objects registered with addCleanup()
+       * are destroyed in registration order before that. Objects
+       * whose destructor would only release arena memory are
+       * dismissed, so that tearing down a tree costs nothing per node.
+       */
+      class Arena
+      {
+      public:
+        explicit Arena(std::size_t _blockSize = 64 * 1024)
+          : current(nullptr), last(nullptr), blockSize(_blockSize), allocated(0), used(0)
+        {
+        }
+
+        Arena(const Arena &) = delete;
+        Arena & operator=(const Arena &) = delete;
+
+        ~Arena()
+        {
+          // parents are registered before their children
+          for(auto & c : cleanups)
+          {
+            if(c.obj)
+            {
+              c.destroy(c.obj);
+            }
+          }
+          for(char * block : blocks)
+          {
+            ::operator delete(block);
+          }
+        }
+
+        void * allocate(std::size_t size, std::size_t align)
+        {
+          std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(current);
+          std::size_t pad = (align - addr % align) % align;
+          if(current == nullptr || pad + size > std::size_t(last - current))
+          {
+            // oversized requests get a block of their own
+            std::size_t n = (size + align > blockSize / 4 ? size + align : blockSize);
+            char * block = static_cast<char*>(::operator new(n));
+            blocks.push_back(block);
+            allocated += n;
+            if(n != blockSize)
+            {
+              used += size;
+              addr = reinterpret_cast<std::uintptr_t>(block);
+              return block + (align - addr % align) % align;
+            }
+            current = block;
+            last = block + n;
+            addr = reinterpret_cast<std::uintptr_t>(current);
+            pad = (align - addr % align) % align;
+          }
+          char * ret = current + pad;
+          current = ret + size;
+          used += size;
+          return ret;
+        }
+
+        template<typename T>
+        void addCleanup(T * obj)
+        {
+          cleanups.push_back(Cleanup{obj, &destroy<T>});
+        }
+
+        /**
+         * number of registered objects, the position of the
+         * next one
+         */
+        std::size_t cleanupCount() const
+        {
+          return cleanups.size();
+        }
+
+        /**
+         * obj registered at position slot is not destroyed
+         */
+        void dismissCleanup(const void * obj, std::size_t slot)
+        {
+          if(slot < cleanups.size() && cleanups[slot].obj == obj)
+          {
+            cleanups[slot].obj = nullptr;
+          }
+        }
+
+        /**
+         * remove the dismissed registrations from position from on,
+         * the positions of later registrations change
+         */
+        void compactCleanups(std::size_t from)
+        {
+          auto end = std::remove_if(cleanups.begin() + std::min(from, cleanups.size()), cleanups.end(),
+                                    [](const Cleanup & c) { return c.obj == nullptr; });
+          cleanups.erase(end, cleanups.end());
+        }
+
+        /**
+         * held while a deferred subtree is parsed into the arena
+         * of a document that is already shared between readers
+         */
+        std::mutex & mutex()
+        {
+          return lock;
+        }
+
+        /**
+         * bytes requested from the global allocator
+         */
+        std::size_t bytesAllocated() const
+        {
+          return allocated;
+        }
+
+        /**
+         * bytes handed out by allocate()
+         */
+        std::size_t bytesUsed() const
+        {
+          return used;
+        }
+
+      private:
+        struct Cleanup
+        {
+          void * obj;
+          void (*destroy)(void *);
+        };
+
+        template<typename T>
+        static void destroy(void * obj)
+        {
+          static_cast<T*>(obj)->~T();
+        }
+
+        std::vector<char*> blocks;
+        std::vector<Cleanup> cleanups;
+        std::mutex lock;
+        char * current;
+        char * last;
+        std::size_t blockSize;
+        std::size_t allocated;
+        std::size_t used;
+      };
+
+      /**
+       * Allocator of the containers in Array and Object.
+       * Without arena it forwards to the global allocator,
+       * deallocation of arena memory is a no-op.
+       * Copies of a container always use the global allocator.
+       */
+      template<typename T>
+      class Allocator
+      {
+      public:
+        typedef T value_type;
+        typedef std::false_type propagate_on_container_copy_assignment;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        Allocator() : arena(nullptr) {}
+        explicit Allocator(Arena * _arena) : arena(_arena) {}
+
+        template<typename U>
+        Allocator(const Allocator<U> & rhs) : arena(rhs.getArena()) {}
+
+        T * allocate(std::size_t n)
+        {
+          if(arena)
+          {
+            return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+          }
+          else
+          {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+          }
+        }
+
+        void deallocate(T * p, std::size_t)
+        {
+          if(!arena)
+          {
+            ::operator delete(p);
+          }
+        }
+
+        Allocator select_on_container_copy_construction() const
+        {
+          return Allocator();
+        }
+
+        Arena * getArena() const
+        {
+          return arena;
+        }
+
+        template<typename U>
+        bool operator==(const Allocator<U> & rhs) const
+        {
+          return arena == rhs.getArena();
+        }
+
+        template<typename U>
+        bool operator!=(const Allocator<U> & rhs) const
+        {
+          return arena != rhs.getArena();
+        }
+
+      private:
+        Arena * arena;
+      };
+    }
+  }
+}
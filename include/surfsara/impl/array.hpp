@@ -28,22 +28,113 @@ SOFTWARE.
 // implementation details don't include directly.
 //
 /////////////////////////////////////////////////////
-inline surfsara::ast::Array::Array()
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace details
+    {
+      /**
+       * non owning view on contiguous elements
+       */
+      template<typename T>
+      class Span
+      {
+      public:
+        typedef T value_type;
+        typedef T * iterator;
+        typedef T * pointer;
+        typedef T & reference;
+
+        Span() : first(nullptr), n(0) {}
+        Span(T * _first, std::size_t _n) : first(_first), n(_n) {}
+
+        template<typename U>
+        Span(const Span<U> & rhs,
+             typename std::enable_if<std::is_convertible<U*, T*>::value>::type* = nullptr)
+          : first(rhs.data()), n(rhs.size()) {}
+
+        T * begin() const { return first; }
+        T * end() const { return first + n; }
+        T * data() const { return first; }
+        std::size_t size() const { return n; }
+        bool empty() const { return n == 0; }
+        T & operator[](std::size_t i) const { return first[i]; }
+
+        Span subspan(std::size_t offset, std::size_t count) const
+        {
+          return Span(first + offset, count);
+        }
+
+      private:
+        T * first;
+        std::size_t n;
+      };
+    }
+  }
+}
+
+inline surfsara::ast::Array::Array() : hashValue(0)
 {
 }
 
-inline surfsara::ast::Array::Array(const std::initializer_list<Node> & l) : data(l)
+inline surfsara::ast::Array::Array(const std::initializer_list<Node> & l) : elements(l), hashValue(0)
+{
+}
+
+inline surfsara::ast::Array::Array(details::Arena & arena)
+  : elements(details::Allocator<Node>(&arena)), hashValue(0)
 {
 }
 
 inline bool surfsara::ast::Array::operator==(const Array & rhs) const
 {
-  return this == &rhs;
+  if(this == &rhs)
+  {
+    return true;
+  }
+  if(elements.size() != rhs.elements.size())
+  {
+    return false;
+  }
+  if(hashValue != 0 && rhs.hashValue != 0 && hashValue != rhs.hashValue)
+  {
+    return false;
+  }
+  for(std::size_t i = 0; i < elements.size(); i++)
+  {
+    if(elements[i] != rhs.elements[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline std::size_t surfsara::ast::Array::hash() const
+{
+  if(hashValue != 0)
+  {
+    return hashValue;
+  }
+  std::size_t h = details::hashCombine(elements.size(), std::type_index(typeid(Array)).hash_code());
+  for(const Node & node : elements)
+  {
+    h = details::hashCombine(h, node.hash());
+  }
+  return (h == 0 ? 1 : h);
+}
+
+inline std::size_t surfsara::ast::Array::cacheHash() const
+{
+  hashValue = hash();
+  return hashValue;
 }
 
 inline void surfsara::ast::Array::forEach(std::function<void(Node & node)> lambda)
 {
-  for(Node & node : data)
+  hashValue = 0;
+  for(Node & node : elements)
   {
     lambda(node);
   }
@@ -51,7 +142,7 @@ inline void surfsara::ast::Array::forEach(std::function<void(Node & node)> lambd
 
 inline void surfsara::ast::Array::forEach(std::function<void(const Node & node)> lambda)const
 {
-  for(const Node & node : data)
+  for(const Node & node : elements)
   {
     lambda(node);
   }
@@ -59,43 +150,156 @@ inline void surfsara::ast::Array::forEach(std::function<void(const Node & node)>
 
 inline std::size_t surfsara::ast::Array::size() const
 {
-  return data.size();
+  return elements.size();
+}
+
+inline bool surfsara::ast::Array::empty() const
+{
+  return elements.empty();
+}
+
+inline std::size_t surfsara::ast::Array::capacity() const
+{
+  return elements.capacity();
+}
+
+inline void surfsara::ast::Array::reserve(std::size_t n)
+{
+  elements.reserve(n);
+}
+
+inline void surfsara::ast::Array::shrinkToFit()
+{
+  elements.shrink_to_fit();
 }
 
 inline void surfsara::ast::Array::pushBack(const Node & node)
 {
-  data.push_back(node);
+  hashValue = 0;
+  elements.push_back(node);
+}
+
+inline void surfsara::ast::Array::pushBack(Node && node)
+{
+  hashValue = 0;
+  elements.push_back(std::move(node));
+}
+
+inline surfsara::ast::Array::iterator surfsara::ast::Array::begin()
+{
+  hashValue = 0;
+  return elements.begin();
 }
 
 inline surfsara::ast::Array::iterator surfsara::ast::Array::end()
 {
-  return data.end();
+  hashValue = 0;
+  return elements.end();
+}
+
+inline surfsara::ast::Array::const_iterator surfsara::ast::Array::begin() const
+{
+  return elements.begin();
+}
+
+inline surfsara::ast::Array::const_iterator surfsara::ast::Array::end() const
+{
+  return elements.end();
+}
+
+inline surfsara::ast::Array::const_iterator surfsara::ast::Array::cbegin() const
+{
+  return elements.cbegin();
+}
+
+inline surfsara::ast::Array::const_iterator surfsara::ast::Array::cend() const
+{
+  return elements.cend();
+}
+
+inline surfsara::ast::Array::reverse_iterator surfsara::ast::Array::rbegin()
+{
+  hashValue = 0;
+  return elements.rbegin();
+}
+
+inline surfsara::ast::Array::reverse_iterator surfsara::ast::Array::rend()
+{
+  hashValue = 0;
+  return elements.rend();
+}
+
+inline surfsara::ast::Array::const_reverse_iterator surfsara::ast::Array::rbegin() const
+{
+  return elements.rbegin();
+}
+
+inline surfsara::ast::Array::const_reverse_iterator surfsara::ast::Array::rend() const
+{
+  return elements.rend();
 }
 
 inline void surfsara::ast::Array::insert(iterator itr, Node value)
 {
-  data.insert(itr, value);
+  hashValue = 0;
+  elements.insert(itr, value);
 }
 
 inline void surfsara::ast::Array::remove(std::size_t i)
 {
-  data.erase(data.begin() + i);
+  hashValue = 0;
+  elements.erase(elements.begin() + i);
 }
 
 
 inline surfsara::ast::Node & surfsara::ast::Array::operator[](std::size_t i)
 {
-  return data.at(i);
+  hashValue = 0;
+  return elements.at(i);
 }
 
 inline const surfsara::ast::Node & surfsara::ast::Array::operator[](std::size_t i) const
 {
-  return data.at(i);
+  return elements.at(i);
+}
+
+inline surfsara::ast::Node & surfsara::ast::Array::unsafeAt(std::size_t i)
+{
+  hashValue = 0;
+  return elements[i];
+}
+
+inline const surfsara::ast::Node & surfsara::ast::Array::unsafeAt(std::size_t i) const
+{
+  return elements[i];
+}
+
+inline surfsara::ast::Node * surfsara::ast::Array::data()
+{
+  hashValue = 0;
+  return elements.data();
+}
+
+inline const surfsara::ast::Node * surfsara::ast::Array::data() const
+{
+  return elements.data();
+}
+
+inline surfsara::ast::Array::Span surfsara::ast::Array::span()
+{
+  hashValue = 0;
+  return Span(elements.data(), elements.size());
+}
+
+inline surfsara::ast::Array::ConstSpan surfsara::ast::Array::span() const
+{
+  return ConstSpan(elements.data(), elements.size());
 }
 
 inline void surfsara::ast::Array::swap(Array & rhs)
 {
-  data.swap(rhs.data);
+  elements.swap(rhs.elements);
+  std::swap(hashValue, rhs.hashValue);
 }
 
 
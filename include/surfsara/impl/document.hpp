@@ -0,0 +1,93 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <surfsara/document.h>
+
+inline surfsara::ast::Document::Document() : arena(new details::Arena())
+{
+}
+
+inline surfsara::ast::Document::Document(Document && rhs)
+  : arena(std::move(rhs.arena)), rootNode(std::move(rhs.rootNode))
+{
+  rhs.arena.reset(new details::Arena());
+}
+
+inline surfsara::ast::Document & surfsara::ast::Document::operator=(Document && rhs)
+{
+  if(this != &rhs)
+  {
+    rootNode = Node();
+    arena = std::move(rhs.arena);
+    rootNode = std::move(rhs.rootNode);
+    rhs.arena.reset(new details::Arena());
+  }
+  return *this;
+}
+
+inline const surfsara::ast::Node & surfsara::ast::Document::root() const
+{
+  return rootNode;
+}
+
+inline void surfsara::ast::Document::parse(const std::string & str, const ParseOptions & options)
+{
+  parse(str.c_str(), str.size(), options);
+}
+
+inline void surfsara::ast::Document::parse(const char * str, std::size_t n, const ParseOptions & options)
+{
+  std::unique_ptr<details::Arena> tmp(new details::Arena());
+  {
+    detail::Parser p(options, *tmp);
+    p.parseChunk(str, n);
+    p.flush();
+    rootNode = Node();
+    arena = std::move(tmp);
+    rootNode = Node(p.takeValue());
+  }
+}
+
+inline std::size_t surfsara::ast::Document::bytesAllocated() const
+{
+  return arena->bytesAllocated();
+}
+
+inline surfsara::ast::Document surfsara::ast::parseDocument(const std::string & str)
+{
+  return parseDocument(str, ParseOptions());
+}
+
+inline surfsara::ast::Document surfsara::ast::parseDocument(const std::string & str, const ParseOptions & options)
+{
+  Document doc;
+  doc.parse(str, options);
+  return doc;
+}
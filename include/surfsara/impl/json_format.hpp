@@ -30,6 +30,7 @@ SOFTWARE.
 #define BOOST_SPIRIT_UNICODE
 #include <boost/regex/pending/unicode_iterator.hpp>
 #include <boost/spirit/include/qi.hpp>
+#include <surfsara/impl/scan.hpp>
 
 namespace surfsara
 {
@@ -81,11 +82,16 @@ namespace surfsara
         }
 
         void operator()(const String & str) const
+        {
+          writeString(str.data(), str.size());
+        }
+
+        void writeString(const char * data, std::size_t size) const
         {
           ost.put('"');
-          typedef boost::u8_to_u32_iterator<std::string::const_iterator> iter_t;
-          iter_t begin = str.begin();
-          iter_t end = str.end();
+          typedef boost::u8_to_u32_iterator<const char *> iter_t;
+          iter_t begin = data;
+          iter_t end = data + size;
           for(auto itr = begin; itr != end; ++itr)
           {
             auto ch = *itr;
@@ -131,22 +137,23 @@ namespace surfsara
           bool first = true;
           std::size_t locIndent = indent + 2;
           ost << "[";
-          arr.forEach([&first, locIndent, this](const Node & node){
-              if(first)
-              {
-                first = false;
-              }
-              else
-              {
-                ost << ",";
-              }
-              if(pretty)
-              {
-                putSpaceNl(ost, locIndent);
-              }
-              detials::JsonNodeVisitor visitor(ost, pretty, indent);
-              node.applyVisitor(visitor);
-          });
+          for(const Node & node : arr)
+          {
+            if(first)
+            {
+              first = false;
+            }
+            else
+            {
+              ost << ",";
+            }
+            if(pretty)
+            {
+              putSpaceNl(ost, locIndent);
+            }
+            detials::JsonNodeVisitor visitor(ost, pretty, indent);
+            visitor.visit(node);
+          }
           if(pretty)
           {
             locIndent-= 2;
@@ -160,34 +167,34 @@ namespace surfsara
           bool first = true;
           std::size_t locIndent = indent + 2;
           ost << "{";
-          obj.forEach([&first, locIndent, this](const String& key, const Node & node) {
-              if(first)
-              {
-                first = false;
-              }
-              else
-              {
-                ost << ",";
-              }
-              if(pretty)
-              {
-                putSpaceNl(ost, locIndent);
-              }
-              Node n(key);
-              {
-                detials::JsonNodeVisitor visitor(ost, false, 0);
-                n.applyVisitor(visitor);
-              }
-              ost << ":";
-              if(pretty)
-              {
-                ost.put(' ');
-              }
-              {
-                detials::JsonNodeVisitor visitor(ost, pretty, locIndent);
-                node.applyVisitor(visitor);
-              }
-            });
+          for(const Object::value_type & p : obj)
+          {
+            if(first)
+            {
+              first = false;
+            }
+            else
+            {
+              ost << ",";
+            }
+            if(pretty)
+            {
+              putSpaceNl(ost, locIndent);
+            }
+            {
+              detials::JsonNodeVisitor visitor(ost, false, 0);
+              visitor(p.first);
+            }
+            ost << ":";
+            if(pretty)
+            {
+              ost.put(' ');
+            }
+            {
+              detials::JsonNodeVisitor visitor(ost, pretty, locIndent);
+              visitor.visit(p.second);
+            }
+          }
           if(pretty)
           {
             locIndent-= 2;
@@ -196,7 +203,67 @@ namespace surfsara
           ost << "}";
         }
 
+        /**
+         * numbers parsed with lazyNumbers are written as they were read,
+         * borrowed strings are written from the input and compact
+         * output of deferred subtrees from their text
+         */
+        void visit(const Node & node)
+        {
+          const String * text = node.numberText();
+          const String * deferred = (pretty ? nullptr : node.deferredText());
+          const char * data;
+          std::size_t size;
+          if(text)
+          {
+            ost << *text;
+          }
+          else if(deferred)
+          {
+            writeCompact(*deferred);
+          }
+          else if(node.stringData(data, size))
+          {
+            writeString(data, size);
+          }
+          else
+          {
+            node.applyVisitor(*this);
+          }
+        }
+
       private:
+        /**
+         * checked JSON text without the white space between tokens
+         * and without the escapes the parser drops
+         */
+        void writeCompact(const String & text) const
+        {
+          bool inString = false;
+          for(std::size_t i = 0; i < text.size(); i++)
+          {
+            char ch = text[i];
+            if(inString && ch == '\\')
+            {
+              ch = text[++i];
+              if(detail::isEscape(ch))
+              {
+                ost.put('\\');
+                ost.put(ch);
+              }
+            }
+            else if(ch == '"')
+            {
+              inString = !inString;
+              ost.put(ch);
+            }
+            else if(inString || !detail::isWhiteSpace(ch))
+            {
+              ost.put(ch);
+            }
+          }
+        }
+
         static void putSpaceNl(std::ostream & ost, std::size_t n)
         {
           ost.put('\n');
@@ -219,7 +286,7 @@ void surfsara::ast::formatJson(std::ostream & ost,
                                std::size_t indent)
 {
   detials::JsonNodeVisitor visitor(ost, pretty, indent);
-  node.applyVisitor(visitor);
+  visitor.visit(node);
 }
 
 
@@ -0,0 +1,574 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <surfsara/json_parallel.h>
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace detail
+    {
+      // smallest chunk worth a thread of its own
+      static const std::size_t parallelMinChunk = 4 * 1024;
+
+      /**
+       * string and bracket state at a position of the input,
+       * depth is relative to the start of the scan
+       */
+      struct ScanState
+      {
+        bool inString;
+        bool escaped;
+        long depth;
+      };
+
+      inline ScanState scanChunk(const char * begin, const char * end, bool inString, bool escaped)
+      {
+        long depth = 0;
+        for(const char * p = begin; p != end; ++p)
+        {
+          char ch = *p;
+          if(inString)
+          {
+            if(escaped) escaped = false;
+            else if(ch == '\\') escaped = true;
+            else if(ch == '"') inString = false;
+          }
+          else
+          {
+            switch(ch)
+            {
+            case '"': inString = true; break;
+            case '[':
+            case '{': depth++; break;
+            case ']':
+            case '}': depth--; break;
+            }
+          }
+        }
+        return ScanState{inString, escaped, depth};
+      }
+
+      /**
+       * first comma between two elements of the top-level container,
+       * end if the chunk has none
+       */
+      inline const char * findSplit(const char * begin, const char * end, ScanState s)
+      {
+        for(const char * p = begin; p != end; ++p)
+        {
+          char ch = *p;
+          if(s.inString)
+          {
+            if(s.escaped) s.escaped = false;
+            else if(ch == '\\') s.escaped = true;
+            else if(ch == '"') s.inString = false;
+          }
+          else
+          {
+            switch(ch)
+            {
+            case '"': s.inString = true; break;
+            case '[':
+            case '{': s.depth++; break;
+            case ']':
+            case '}': s.depth--; break;
+            case ',':
+              if(s.depth == 1)
+              {
+                return p;
+              }
+            }
+          }
+        }
+        return end;
+      }
+
+      /**
+       * run func(0) ... func(n-1) on n threads,
+       * the first exception in index order is rethrown
+       */
+      template<typename F>
+      inline void runParallel(std::size_t n, const F & func)
+      {
+        std::vector<std::exception_ptr> errors(n);
+        std::vector<std::thread> threads;
+        for(std::size_t i = 1; i < n; i++)
+        {
+          threads.push_back(std::thread([i, &func, &errors](){
+                try
+                {
+                  func(i);
+                }
+                catch(...)
+                {
+                  errors[i] = std::current_exception();
+                }
+              }));
+        }
+        try
+        {
+          func(0);
+        }
+        catch(...)
+        {
+          errors[0] = std::current_exception();
+        }
+        for(std::thread & t : threads)
+        {
+          t.join();
+        }
+        for(std::exception_ptr & e : errors)
+        {
+          if(e)
+          {
+            std::rethrow_exception(e);
+          }
+        }
+      }
+    }
+  }
+}
+
+inline surfsara::ast::Node surfsara::ast::parseJsonParallel(const std::string & str,
+                                                            std::size_t threads,
+                                                            const ParseOptions & options)
+{
+  if(threads == 0)
+  {
+    threads = std::max<std::size_t>(1u, std::thread::hardware_concurrency());
+  }
+  std::size_t first = str.find_first_not_of(" \t\n\r\v\f");
+  std::size_t last = str.find_last_not_of(" \t\n\r\v\f");
+  std::size_t n = std::min(threads, str.size() / detail::parallelMinChunk);
+  if(n < 2 || first == std::string::npos || first == last ||
+     !((str[first] == '[' && str[last] == ']') || (str[first] == '{' && str[last] == '}')))
+  {
+    return parseJson(str, options);
+  }
+  bool isObject = (str[first] == '{');
+
+  // content between the outer brackets, split into n chunks
+  const char * begin = str.c_str() + first + 1;
+  const char * end = str.c_str() + last;
+  std::size_t chunkSize = (end - begin) / n;
+  std::vector<const char*> bounds;
+  for(std::size_t i = 0; i < n; i++)
+  {
+    bounds.push_back(begin + i * chunkSize);
+  }
+  bounds.push_back(end);
+
+  // speculate on both string states at the start of each chunk
+  std::vector<detail::ScanState> outside(n);
+  std::vector<detail::ScanState> inside(n);
+  detail::runParallel(n, [&](std::size_t i){
+      outside[i] = detail::scanChunk(bounds[i], bounds[i + 1], false, false);
+      if(i > 0)
+      {
+        inside[i] = detail::scanChunk(bounds[i], bounds[i + 1], true, false);
+      }
+    });
+
+  // resolve the actual state at each chunk start
+  std::vector<detail::ScanState> starts(n);
+  detail::ScanState s{false, false, 1};
+  for(std::size_t i = 0; i < n; i++)
+  {
+    starts[i] = s;
+    detail::ScanState delta;
+    if(!s.inString)
+    {
+      delta = outside[i];
+    }
+    else if(!s.escaped)
+    {
+      delta = inside[i];
+    }
+    else
+    {
+      // a backslash ended the previous chunk
+      delta = detail::scanChunk(bounds[i], bounds[i + 1], true, true);
+    }
+    s = detail::ScanState{delta.inString, delta.escaped, s.depth + delta.depth};
+  }
+  if(s.inString || s.depth != 1)
+  {
+    // malformed, report the error of the sequential parser
+    return parseJson(str, options);
+  }
+
+  // cut at the first top-level comma of each chunk
+  std::vector<const char*> cuts(n + 1);
+  cuts[0] = begin;
+  cuts[n] = end;
+  detail::runParallel(n, [&](std::size_t i){
+      if(i > 0)
+      {
+        cuts[i] = detail::findSplit(bounds[i], bounds[i + 1], starts[i]);
+      }
+    });
+
+  std::vector<std::pair<const char*, const char*>> segments;
+  for(std::size_t i = 0; i < n; i++)
+  {
+    if(i == 0 || cuts[i] != bounds[i + 1])
+    {
+      // the comma is not part of the segment
+      segments.push_back(std::make_pair(cuts[i] + (i > 0 ? 1 : 0), end));
+      if(segments.size() > 1)
+      {
+        segments[segments.size() - 2].second = cuts[i];
+      }
+    }
+  }
+  for(const auto & segment : segments)
+  {
+    bool blank = std::all_of(segment.first, segment.second, [](char ch){
+        return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\v' || ch == '\f';
+      });
+    if(segments.size() > 1 && blank)
+    {
+      // [,1] or [1,]
+      throw std::runtime_error("unexpected character ','");
+    }
+  }
+
+  // parse the segments, each one as an array or object of its own
+  std::vector<Node> parts(segments.size());
+  detail::runParallel(segments.size(), [&](std::size_t i){
+      detail::Parser p(options);
+      p.parseChunk(isObject ? "{" : "[", 1);
+      p.parseChunk(segments[i].first, segments[i].second - segments[i].first);
+      p.parseChunk(isObject ? "}" : "]", 1);
+      p.flush();
+      parts[i] = Node(p.takeValue());
+    });
+
+  // stitch the partial containers
+  if(isObject)
+  {
+    Node ret = Object();
+    Object & obj(ret.as<Object>());
+    for(Node & part : parts)
+    {
+      for(Object::value_type & p : part.as<Object>())
+      {
+        obj.set(p.first, std::move(p.second));
+      }
+    }
+    return ret;
+  }
+  else
+  {
+    std::size_t size = 0;
+    for(const Node & part : parts)
+    {
+      size += part.as<Array>().size();
+    }
+    Node ret = Array();
+    Array & arr(ret.as<Array>());
+    arr.reserve(size);
+    for(Node & part : parts)
+    {
+      for(Node & node : part.as<Array>())
+      {
+        arr.pushBack(std::move(node));
+      }
+    }
+    return ret;
+  }
+}
+
+struct surfsara::ast::ParserPool::Worker
+{
+  Worker(const ParseOptions & options)
+    : parser(options), fileParser(options), begin(0), end(0)
+  {
+  }
+
+  detail::Parser parser;
+
+  // the buffer is reused, strings cannot be borrowed from it
+  detail::Parser fileParser;
+  std::string buffer;
+
+  // range of documents not yet taken
+  std::mutex mutex;
+  std::size_t begin;
+  std::size_t end;
+};
+
+inline surfsara::ast::ParserPool::ParserPool(std::size_t nthreads, const ParseOptions & _options)
+  : options(_options), task(nullptr), results(nullptr), batchOptions(nullptr),
+    active(0), generation(0), busy(0), stop(false)
+{
+  if(nthreads == 0)
+  {
+    nthreads = std::max<std::size_t>(1u, std::thread::hardware_concurrency());
+  }
+  for(std::size_t i = 0; i < nthreads; i++)
+  {
+    workers.emplace_back(new Worker(options));
+  }
+  for(std::size_t i = 0; i < nthreads; i++)
+  {
+    threads.push_back(std::thread([this, i](){ work(i); }));
+  }
+}
+
+inline surfsara::ast::ParserPool::~ParserPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  wake.notify_all();
+  for(std::thread & t : threads)
+  {
+    t.join();
+  }
+}
+
+inline std::size_t surfsara::ast::ParserPool::size() const
+{
+  return workers.size();
+}
+
+inline std::vector<surfsara::ast::Node>
+surfsara::ast::ParserPool::parse(const std::vector<std::string> & documents)
+{
+  return parse(documents, options);
+}
+
+inline std::vector<surfsara::ast::Node>
+surfsara::ast::ParserPool::parseFiles(const std::vector<std::string> & files)
+{
+  return parseFiles(files, options);
+}
+
+inline std::vector<surfsara::ast::Node>
+surfsara::ast::ParserPool::parse(const std::vector<std::string> & documents,
+                                 const ParseOptions & batchOptions,
+                                 std::size_t nthreads)
+{
+  std::vector<Node> ret;
+  run(documents.size(), [&documents](Worker & worker, std::size_t i){
+      const std::string & doc(documents[i]);
+      worker.parser.reset();
+      worker.parser.parseChunk(doc.c_str(), doc.size());
+      worker.parser.flush();
+      return Node(worker.parser.takeValue());
+    }, ret, batchOptions, nthreads);
+  return ret;
+}
+
+inline std::vector<surfsara::ast::Node>
+surfsara::ast::ParserPool::parseFiles(const std::vector<std::string> & files,
+                                      const ParseOptions & batchOptions,
+                                      std::size_t nthreads)
+{
+  std::vector<Node> ret;
+  run(files.size(), [&files](Worker & worker, std::size_t i){
+      std::ifstream ist(files[i], std::ios::binary);
+      if(!ist)
+      {
+        throw std::runtime_error("cannot open " + files[i]);
+      }
+      ist.seekg(0, std::ios::end);
+      worker.buffer.resize(static_cast<std::size_t>(ist.tellg()));
+      ist.seekg(0, std::ios::beg);
+      if(!ist.read(&worker.buffer[0], worker.buffer.size()))
+      {
+        throw std::runtime_error("cannot read " + files[i]);
+      }
+      worker.fileParser.reset();
+      worker.fileParser.parseChunk(worker.buffer.c_str(), worker.buffer.size());
+      worker.fileParser.flush();
+      return Node(worker.fileParser.takeValue());
+    }, ret, batchOptions, nthreads);
+  return ret;
+}
+
+inline surfsara::ast::ParserPool & surfsara::ast::ParserPool::shared()
+{
+  static ParserPool pool;
+  return pool;
+}
+
+inline void surfsara::ast::ParserPool::run(std::size_t n, const Task & _task, std::vector<Node> & _results,
+                                           const ParseOptions & _options, std::size_t nthreads)
+{
+  // done.wait() releases mutex, a second batch must not start meanwhile
+  std::lock_guard<std::mutex> serial(batch);
+  std::vector<std::exception_ptr> batchErrors;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    _results.resize(n);
+    errors.assign(n, std::exception_ptr());
+    active = workers.size();
+    if(nthreads != 0)
+    {
+      active = std::min(active, nthreads);
+    }
+    // no idle threads for small batches
+    active = std::min(active, std::max<std::size_t>(1u, n));
+    for(std::size_t i = 0; i < workers.size(); i++)
+    {
+      std::lock_guard<std::mutex> range(workers[i]->mutex);
+      workers[i]->begin = (i < active ? n * i / active : 0);
+      workers[i]->end = (i < active ? n * (i + 1) / active : 0);
+    }
+    task = &_task;
+    results = &_results;
+    batchOptions = &_options;
+    busy = active;
+    generation++;
+    wake.notify_all();
+    done.wait(lock, [this](){ return busy == 0; });
+    task = nullptr;
+    results = nullptr;
+    batchOptions = nullptr;
+    batchErrors.swap(errors);
+  }
+  for(std::exception_ptr & e : batchErrors)
+  {
+    if(e)
+    {
+      std::rethrow_exception(e);
+    }
+  }
+}
+
+inline void surfsara::ast::ParserPool::work(std::size_t i)
+{
+  std::size_t seen = 0;
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this, seen](){ return stop || generation != seen; });
+      if(stop)
+      {
+        return;
+      }
+      seen = generation;
+      if(i >= active)
+      {
+        continue;
+      }
+    }
+    Worker & worker(*workers[i]);
+    ParseOptions fileOptions(*batchOptions);
+    fileOptions.borrow = false;
+    worker.parser.reset(*batchOptions);
+    worker.fileParser.reset(fileOptions);
+    std::size_t item;
+    while(next(i, item))
+    {
+      try
+      {
+        (*results)[item] = (*task)(worker, item);
+      }
+      catch(...)
+      {
+        // each item has its own slot
+        errors[item] = std::current_exception();
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if(--busy == 0)
+      {
+        done.notify_all();
+      }
+    }
+  }
+}
+
+inline bool surfsara::ast::ParserPool::next(std::size_t i, std::size_t & item)
+{
+  Worker & own(*workers[i]);
+  {
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if(own.begin < own.end)
+    {
+      item = own.begin++;
+      return true;
+    }
+  }
+  for(std::size_t k = 1; k < active; k++)
+  {
+    Worker & victim(*workers[(i + k) % active]);
+    std::size_t first;
+    std::size_t last;
+    {
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if(victim.begin == victim.end)
+      {
+        continue;
+      }
+      // steal the upper half
+      first = victim.begin + (victim.end - victim.begin) / 2;
+      last = victim.end;
+      victim.end = first;
+    }
+    std::lock_guard<std::mutex> lock(own.mutex);
+    item = first;
+    own.begin = first + 1;
+    own.end = last;
+    return true;
+  }
+  return false;
+}
+
+inline std::vector<surfsara::ast::Node>
+surfsara::ast::parseJsonBatch(const std::vector<std::string> & documents,
+                              std::size_t threads,
+                              const ParseOptions & options)
+{
+  return ParserPool::shared().parse(documents, options, threads);
+}
+
+inline std::vector<surfsara::ast::Node>
+surfsara::ast::parseJsonFiles(const std::vector<std::string> & files,
+                              std::size_t threads,
+                              const ParseOptions & options)
+{
+  return ParserPool::shared().parseFiles(files, options, threads);
+}
@@ -1,13 +1,24 @@
 #pragma once
+#include <algorithm>
 #include <typeinfo>
 #include <typeindex>
 #include <tuple>
 #include <string>
 #include <exception>
 #include <memory>
+#include <mutex>
+#include <cassert>
+#include <cstring>
+#include <limits>
 #include <iostream>
 #include <type_traits>
 #include <surfsara/ast.h>
+#include <surfsara/json_parser.h>
+#include <surfsara/json_validator.h>
+#include <surfsara/impl/scan.hpp>
+#include <surfsara/impl/path_filter.hpp>
+#include <surfsara/impl/recycler.hpp>
+#include <surfsara/impl/key_predictor.hpp>
 
 namespace surfsara
 {
@@ -52,39 +63,217 @@ namespace surfsara
           STRING_ESC     = 42,
           STRING_END     = 43,
           STRING_UNI     = 44,
-          END            = 50
+          STRING_BORROWED= 45,
+          SKIP           = 46,
+          SKIP_END       = 49,
+          END            = 50,
+          STRING_LOW     = 51,
+          STRING_LOW_U   = 52
         };
 
+        /**
+         * receives the nodes that match the filter in event mode,
+         * returning false stops the parser
+         */
+        typedef std::function<bool(Node & node,
+                                   const std::vector<std::string> & path)> Callback;
+
 
         typedef Node::Value Value;
         Parser(std::size_t _line=0, std::size_t _col=0)
-          : line(_line), col(_col),state({BEGIN}) 
+          : arena(nullptr), cleanupStart(0), line(_line), col(_col), consumed(0), chunk(nullptr),
+            unicode(0), hexDigits(0), highSurrogate(0), state({BEGIN}), objectDepth(0), depth(0), str(nullptr),
+            cursor(nullptr), borrowed(nullptr), discard(false), stopped(false)
+        {
+        };
+
+        explicit Parser(const ParseOptions & _options, std::size_t _line=0, std::size_t _col=0)
+          : options(_options), arena(nullptr), cleanupStart(0), line(_line), col(_col), consumed(0), chunk(nullptr),
+            unicode(0), hexDigits(0), highSurrogate(0), state({BEGIN}), objectDepth(0), depth(0), str(nullptr),
+            cursor(nullptr), borrowed(nullptr), discard(false), stopped(false)
+        {
+          predictor.configure(options.predictKeys, options.validateUtf8, options.strings);
+          if(options.dedupe)
+          {
+            deduplicator.reset(new details::Deduplicator());
+          }
+        };
+
+        /**
+         * strings, arrays and objects are allocated in the arena,
+         * which must outlive the parsed value
+         */
+        Parser(const ParseOptions & _options, details::Arena & _arena)
+          : Parser(_options)
+        {
+          arena = &_arena;
+          cleanupStart = arena->cleanupCount();
+        };
+
+        /**
+         * only nodes selected by the filter are built,
+         * the filter must outlive the parser
+         */
+        Parser(const ParseOptions & _options, const PathFilter & _filter)
+          : Parser(_options)
         {
+          paths.attach(_filter, false);
         };
 
+        /**
+         * event mode: nodes selected by the filter are passed to the
+         * callback instead of being attached to their parent, the
+         * containers on the way to them are dropped when complete
+         */
+        Parser(const ParseOptions & _options, const PathFilter & _filter, const Callback & _callback)
+          : Parser(_options)
+        {
+          paths.attach(_filter, true);
+          callback = _callback;
+        };
+
+        /**
+         * true if a callback returned false, the rest of the input is ignored
+         */
+        bool isStopped() const
+        {
+          return stopped;
+        }
+
+        /**
+         * continue after a callback returned false,
+         * with the input following the consumed part
+         */
+        void resume()
+        {
+          stopped = false;
+        }
+
+        /**
+         * prepare for the next document with the same options,
+         * the internal buffers keep their capacity unless a previous
+         * document made them larger than typical documents need
+         */
+        void reset()
+        {
+          shrink();
+          line = 0;
+          col = 0;
+          consumed = 0;
+          chunk = nullptr;
+          utf8.reset();
+          highSurrogate = 0;
+          state.assign(1, BEGIN);
+          value.clear();
+          cleanupSlots.clear();
+          if(arena)
+          {
+            cleanupStart = arena->cleanupCount();
+          }
+          objectDepth = 0;
+          depth = 0;
+          number.clear();
+          text.clear();
+          str = nullptr;
+          cursor = nullptr;
+          borrowed = nullptr;
+          skipped.clear();
+          discard = false;
+          paths.reset();
+          stopped = false;
+          recycler.reset();
+          predictor.reset();
+          if(deduplicator)
+          {
+            deduplicator->clear();
+          }
+        }
+
+        /**
+         * prepare for the next document with other options
+         */
+        void reset(const ParseOptions & _options)
+        {
+          options = _options;
+          predictor.configure(options.predictKeys, options.validateUtf8, options.strings);
+          deferredOptions.reset();
+          if(options.dedupe && !deduplicator)
+          {
+            deduplicator.reset(new details::Deduplicator());
+          }
+          reset();
+        }
+
+        /**
+         * the payloads of old are reused by the next document
+         * as far as its shape matches, see surfsara::ast::parseInto()
+         */
+        void recycle(Value && old)
+        {
+          recycler.start(std::move(old));
+        }
+
         const Value & getValue() const
         {
           return value.front();
         }
 
+        /**
+         * move the parsed value out of the parser
+         */
+        Value takeValue()
+        {
+          return std::move(value.front());
+        }
+
         State getState() const
         {
           return state.back();
         }
 
+        /**
+         * approximate number of bytes held by the internal buffers
+         */
+        std::size_t retainedBytes() const
+        {
+          std::size_t n = (state.capacity() * sizeof(State) +
+                           value.capacity() * sizeof(Value) +
+                           keys.capacity() * sizeof(String) +
+                           number.capacity() + text.capacity() + skipped.capacity() +
+                           paths.retainedBytes() + recycler.retainedBytes() +
+                           predictor.retainedBytes());
+          for(const String & key : keys)
+          {
+            n += key.capacity();
+          }
+          return n;
+        }
+
+        /**
+         * number of object keys remembered for prediction
+         */
+        std::size_t learnedKeys() const
+        {
+          return predictor.learnedKeys();
+        }
+
+        /**
+         * line and column are derived from the consumed input when
+         * asked for, the parser itself only counts bytes
+         */
         std::size_t getLine() const
         {
-          return line;
+          return currentPos<0>();
         }
 
         std::size_t getCol() const
         {
-          return col;
+          return currentPos<1>();
         }
 
         std::tuple<std::size_t, std::size_t, Parser::State> getPos() const
         {
-          return std::tuple<std::size_t, std::size_t, Parser::State>(line, col, state.back());
+          return std::tuple<std::size_t, std::size_t, Parser::State>(currentPos<0>(), currentPos<1>(), state.back());
         }
 
         void parse(const std::string & str)
@@ -98,25 +287,84 @@ namespace surfsara
           parseChunk(str.c_str(), str.size());
         }
 
-        void parseChunk(const char * str, std::size_t n)
+        /**
+         * returns the number of characters consumed,
+         * less than n only if the parser was stopped
+         */
+        std::size_t parseChunk(const char * str, std::size_t n)
         {
-          for(std::size_t i = 0; i < n; i++)
+          PayloadPoolScope pooled(options.poolPayloads);
+          std::size_t i = 0;
+          chunk = str;
+          try
           {
-            const char * ptr = str + i;
-            if(*ptr == '\n')
+            while(i < n && !stopped)
             {
-              line++;
-              col = 0;
+              if(isSkipping())
+              {
+                i = skipChunk(str, i, n);
+                continue;
+              }
+              const char * ptr = str + i++;
+              cursor = ptr;
+              dispatch(*ptr);
+              if(predictor.pending() && predictor.predict(objectDepth - 1, str, i, n, keys[objectDepth - 1]))
+              {
+                state.back() = STRING_END;
+              }
+              if(state.back() == STRING_ESC)
+              {
+                i = scanEscapes(str, i, n);
+              }
+              if(state.back() == STRING || state.back() == STRING_BORROWED)
+              {
+                i = scanString(str, i, n);
+              }
             }
-            else if(*ptr != '\r')
+          }
+          catch(...)
+          {
+            // the chunk may not outlive the exception,
+            // keep the position of the offending character
+            if(cursor)
             {
-              col++;
+              advance(str, cursor + 1, line, col);
+              consumed += cursor + 1 - str;
+              cursor = nullptr;
             }
-            parseChar(*ptr);
+            throw;
+          }
+          if(state.back() == STRING_BORROWED)
+          {
+            // the next chunk may live elsewhere
+            unborrow(str + i);
           }
+          advance(str, str + i, line, col);
+          cursor = nullptr;
+          consumed += i;
+          return i;
         }
 
         void parseChar(char ch)
+        {
+          PayloadPoolScope pooled(options.poolPayloads);
+          consumed++;
+          dispatch(ch);
+        }
+
+        /**
+         * offset of the current character from the start of the document
+         */
+        std::size_t getOffset() const
+        {
+          if(cursor)
+          {
+            return consumed + (cursor - chunk);
+          }
+          return consumed ? consumed - 1 : 0;
+        }
+
+        void dispatch(char ch)
         {
           switch(state.back())
           {
@@ -232,9 +480,35 @@ namespace surfsara
           case STRING_UNI:
             parseStringUniCode(ch);
             break;
+          case STRING_LOW:
+            if(ch == '\\') state.back() = STRING_LOW_U;
+            else invalidUnicode();
+            break;
+          case STRING_LOW_U:
+            if(ch == 'u') beginUniCode();
+            else invalidUnicode();
+            break;
+          case STRING_BORROWED:
+            parseBorrowedString(ch);
+            break;
           case STRING_END:
             finalizeState(ch);
             break;
+          case SKIP:
+            if(!discard)
+            {
+              skipped.push_back(ch);
+            }
+            skipper.feedValue(&ch, 1);
+            endSkip();
+            break;
+          case SKIP_END:
+            if(!discard)
+            {
+              value.back() = newDeferred();
+            }
+            finalizeState(ch);
+            break;
 
           case END:
             if(ch != '\0' && !isWhiteSpace(ch))
@@ -247,31 +521,243 @@ namespace surfsara
 
         void flush()
         {
-          parseChar('\0');
+          PayloadPoolScope pooled(options.poolPayloads);
+          switch(state.back())
+          {
+          case STRING:
+          case STRING_ESC:
+          case STRING_UNI:
+          case STRING_LOW:
+          case STRING_LOW_U:
+          case STRING_BORROWED:
+          case SKIP:
+            // a null character would be part of the string
+            syntaxError("unexpected end of input");
+            break;
+          default:
+            dispatch('\0');
+          }
+          if(arena)
+          {
+            arena->compactCleanups(cleanupStart);
+          }
         }
 
       private:
+        ParseOptions options;
+        details::Arena * arena;
+        // registrations of open containers with the arena
+        std::vector<std::size_t> cleanupSlots;
+        // registrations of earlier documents are not compacted again
+        std::size_t cleanupStart;
+        // position at the start of the current chunk
         std::size_t line;
         std::size_t col;
-        
+
+        // bytes of the document before the current chunk
+        std::size_t consumed;
+        const char * chunk;
+        // state of ParseOptions::validateUtf8 within the current string
+        Utf8Checker utf8;
+
+        // \u escape being decoded
+        std::uint32_t unicode;
+        unsigned hexDigits;
+        std::uint32_t highSurrogate;
         std::vector<State> state;
         std::vector<Value> value;
 
+        // key of the current member for each open object,
+        // the buffers are reused by sibling objects
+        std::vector<String> keys;
+        std::size_t objectDepth;
+
+        // number of open arrays and objects
+        std::size_t depth;
+
+        // text of the number being parsed
+        String number;
+
+        // text of a string value that may be interned
+        String text;
+
+        // target of the string being parsed, a value or a key
+        String * str;
+
+        // position of the current character in a contiguous input
+        const char * cursor;
+
+        // start of the borrowed string being parsed
+        const char * borrowed;
 
-        bool isWhiteSpace(char ch)
+        // text of the deferred subtree being skipped, the skipped
+        // value is checked by the validator
+        String skipped;
+        JsonValidator skipper;
+
+        // the skipped value is not kept
+        bool discard;
+
+        // matches the values against the paths of the filter
+        PathMatcher paths;
+        Callback callback;
+        bool stopped;
+
+        // takes over the payloads of the tree passed to recycle()
+        Recycler recycler;
+
+        // predicts the keys of an object from the previous object
+        // at the same depth
+        KeyPredictor predictor;
+
+        // options of the parsers that expand deferred subtrees
+        std::shared_ptr<const ParseOptions> deferredOptions;
+        std::unique_ptr<details::Deduplicator> deduplicator;
+
+
+        // larger buffers are released by reset(), so that a single
+        // huge document does not stay in a long-lived parser
+        static const std::size_t maxRetainedDepth = 1024;
+        static const std::size_t maxRetainedSize = 64 * 1024;
+
+        template<typename T>
+        static void release(T & buffer, std::size_t maxCapacity)
         {
-          switch(ch)
+          if(buffer.capacity() > maxCapacity)
           {
-          case ' ':
-          case '\r':
-          case '\n':
-          case '\t':
-          case '\v':
-          case '\f':
-            return true;
-            break;
+            T().swap(buffer);
+          }
+        }
+
+        void shrink()
+        {
+          release(state, maxRetainedDepth);
+          release(value, maxRetainedDepth);
+          release(number, maxRetainedSize);
+          release(text, maxRetainedSize);
+          release(skipped, maxRetainedSize);
+          release(keys, maxRetainedDepth);
+          paths.shrink(maxRetainedDepth);
+          recycler.shrink(maxRetainedDepth);
+          predictor.shrink(maxRetainedDepth);
+          for(String & key : keys)
+          {
+            release(key, maxRetainedSize);
+          }
+        }
+
+        Value newString()
+        {
+          if(arena)
+          {
+            return Value(details::Payload<String>::createIn(*arena));
+          }
+          return Value(String());
+        }
+
+        Value newArray()
+        {
+          if(arena)
+          {
+            return Value(details::Payload<Array>::createIn(*arena, *arena));
+          }
+          return Value(Array());
+        }
+
+        Value newObject()
+        {
+          if(arena)
+          {
+            return Value(details::Payload<Object>::createIn(*arena, *arena));
+          }
+          return Value(Object());
+        }
+
+        /**
+         * remember where the container on top was registered
+         * with the arena, it is completed after its children
+         */
+        void reserveCleanup()
+        {
+          if(arena)
+          {
+            cleanupSlots.push_back(arena->cleanupCount() - 1);
+          }
+        }
+
+        /**
+         * the arena only destroys complete values that own memory
+         * outside of it
+         */
+        void dismissCleanup()
+        {
+          if(state.back() == ARRAY_END || state.back() == OBJECT_END)
+          {
+            value.back().dismissCleanup(*arena, cleanupSlots.back());
+            cleanupSlots.pop_back();
+          }
+          else if(!isKey() && !value.back().isA<Array>() && !value.back().isA<Object>())
+          {
+            // a leaf is registered last
+            value.back().dismissCleanup(*arena, arena->cleanupCount() - 1);
+          }
+        }
+
+        bool isKey() const
+        {
+          State parent = *(state.rbegin() + 1);
+          return parent == OBJECT_BEGIN || parent == OBJECT_NEXT;
+        }
+
+        void finalizeString()
+        {
+          if(text.size() <= options.strings->maxLength())
+          {
+            value.back() = options.strings->internValue(text);
+          }
+          else if(recycler.reusable(typeid(String)))
+          {
+            value.back() = recycler.take();
+            value.back().as<String>().assign(text);
+          }
+          else
+          {
+            value.back() = newString();
+            value.back().as<String>().swap(text);
           }
-          return false;
+        }
+
+        void compactValue()
+        {
+          if(state.back() == STRING_END && !isKey())
+          {
+            if(!value.back().isShared() && !value.back().isLazy())
+            {
+              value.back().as<String>().shrink_to_fit();
+            }
+          }
+          else if(arena)
+          {
+            // shrinking arena storage would only allocate again
+            return;
+          }
+          else if(state.back() == ARRAY_END)
+          {
+            value.back().as<Array>().shrinkToFit();
+          }
+          else if(state.back() == OBJECT_END)
+          {
+            value.back().as<Object>().shrinkToFit();
+          }
+        }
+
+        void beginKey()
+        {
+          state.push_back(STRING);
+          String & key(keys[objectDepth - 1]);
+          key.clear();
+          str = &key;
+          predictor.beginKey(objectDepth - 1, cursor != nullptr);
         }
 
         /////////////////////////////////////////////
@@ -291,11 +777,58 @@ namespace surfsara
         {
           if(!isWhiteSpace(ch))
           {
+            PathFilter::Match match = PathFilter::FULL;
+            if(paths.enabled())
+            {
+              bool isContainer = (ch == '[' || ch == '{');
+              match = paths.begin(depth, state.back() == OBJECT_VALUE ? &keys[objectDepth - 1] : nullptr, isContainer);
+              if(match == PathFilter::NONE && (isContainer || ch == '"'))
+              {
+                beginSkip(ch, true);
+                return;
+              }
+            }
+            if(recycler.active() && depth > 0)
+            {
+              // the root was set by recycle()
+              if(state.back() == OBJECT_VALUE)
+              {
+                recycler.takeMember(depth, value.back().as<Object>(), keys[objectDepth - 1]);
+              }
+              else
+              {
+                recycler.takeElement(depth, value.back().as<Array>());
+              }
+            }
             switch(ch)
             {
             case '"':
+              if(options.borrow && cursor)
+              {
+                state.push_back(STRING_BORROWED);
+                value.push_back(Value(Null()));
+                borrowed = cursor + 1;
+                break;
+              }
               state.push_back(STRING);
-              value.push_back(Value(std::string("")));
+              if(options.strings)
+              {
+                // the value is created when the text is complete
+                value.push_back(Value(Null()));
+                text.clear();
+                str = &text;
+              }
+              else if(recycler.reusable(typeid(String)))
+              {
+                value.push_back(recycler.take());
+                str = &value.back().as<String>();
+                str->clear();
+              }
+              else
+              {
+                value.push_back(newString());
+                str = &value.back().as<String>();
+              }
               break;
             case 't':
               state.push_back(T);
@@ -310,30 +843,37 @@ namespace surfsara
               value.push_back(Value(Null()));
               break;
             case '[':
-              state.push_back(ARRAY_BEGIN);
-              value.push_back(Value(Array()));
-              break;
             case '{':
-              state.push_back(OBJECT_BEGIN);
-              value.push_back(Value(Object()));
+              if(match == PathFilter::FULL && defer())
+              {
+                beginSkip(ch, false);
+                break;
+              }
+              else if(ch == '[')
+              {
+                beginArray();
+              }
+              else
+              {
+                beginObject();
+              }
+              paths.open(depth, match);
               break;
             case '-':
-              state.push_back(DIGIT);
-              value.push_back(Value(std::string("-")));
-              break;
+
             case '+':
               state.push_back(DIGIT);
-              value.push_back(Value(std::string("+")));
+              number.assign(1, ch);
               break;
             case '.':
               state.push_back(FRAC_DIGIT);
-              value.push_back(Value(std::string(".")));
+              number.assign(1, ch);
               break;
             default:
               if(ch >= '0' && ch <= '9')
               {
                 state.push_back(DIGIT);
-                value.push_back(Value(std::string({ch})));
+                number.assign(1, ch);
               }
               else
               {
@@ -343,6 +883,163 @@ namespace surfsara
           }
         }
 
+        void beginArray()
+        {
+          state.push_back(ARRAY_BEGIN);
+          value.push_back(recycler.reusable(typeid(Array)) ? recycler.take() : newArray());
+          reserveCleanup();
+          depth++;
+          recycler.open(depth, value.back());
+        }
+
+        void beginObject()
+        {
+          state.push_back(OBJECT_BEGIN);
+          if(keys.size() == objectDepth)
+          {
+            keys.push_back(String());
+          }
+          predictor.enterObject(objectDepth);
+          objectDepth++;
+          value.push_back(recycler.reusable(typeid(Object)) ? recycler.take() : newObject());
+          reserveCleanup();
+          depth++;
+          recycler.open(depth, value.back());
+        }
+
+        /**
+         * true if the array or object that starts here is kept as text
+         */
+        bool defer() const
+        {
+          if(options.deferDepth && depth >= options.deferDepth)
+          {
+            return true;
+          }
+          return (!options.deferKeys.empty() && state.back() == OBJECT_VALUE &&
+                  options.deferKeys.count(keys[objectDepth - 1]));
+        }
+
+        /**
+         * skip an array, object or string, with discard the
+         * value is dropped instead of being deferred
+         */
+        void beginSkip(char ch, bool _discard)
+        {
+          discard = _discard;
+          value.push_back(Value(Null()));
+          state.push_back(SKIP);
+          if(!discard)
+          {
+            skipped.assign(1, ch);
+          }
+          skipper.reset();
+          skipper.feedValue(&ch, 1);
+        }
+
+        /**
+         * pass the completed child to the callback
+         */
+        void emit()
+        {
+          std::vector<std::string> path;
+          std::size_t d = 0;
+          std::size_t o = 0;
+          for(State s : state)
+          {
+            if(s >= ARRAY_BEGIN && s <= ARRAY_END)
+            {
+              path.push_back(std::to_string(paths.index(++d)));
+            }
+            else if(s >= OBJECT_BEGIN && s <= OBJECT_END)
+            {
+              path.push_back(keys[o++]);
+              ++d;
+            }
+          }
+          Node node(std::move(value.back()));
+          if(!callback(node, path))
+          {
+            stopped = true;
+          }
+        }
+
+        bool isSkipping() const
+        {
+          return state.back() == SKIP;
+        }
+
+        /**
+         * report an error of the skipped value, leave the skip state
+         * once it is complete
+         */
+        void endSkip()
+        {
+          if(!skipper.result().valid)
+          {
+            syntaxError(skipper.result().message);
+          }
+          if(skipper.complete())
+          {
+            state.back() = SKIP_END;
+          }
+        }
+
+        /**
+         * skip a deferred subtree within a chunk, the text
+         * is appended at once. Returns the next position.
+         */
+        std::size_t skipChunk(const char * str, std::size_t i, std::size_t n)
+        {
+          std::size_t len = skipper.feedValue(str + i, n - i);
+          if(!discard)
+          {
+            skipped.append(str + i, len);
+          }
+          endSkip();
+          return i + len;
+        }
+
+        Value newDeferred()
+        {
+          if(!deferredOptions)
+          {
+            std::shared_ptr<ParseOptions> nested = std::make_shared<ParseOptions>(options);
+            // the subtree is the root of the nested parser
+            nested->deferDepth = (options.deferDepth ? 1 : 0);
+            // the text is owned by the deferred node
+            nested->borrow = false;
+            deferredOptions = nested;
+          }
+          bool isObject = (skipped[0] == '{');
+          if(arena)
+          {
+            return Value(details::Payload<details::Deferred>::createIn(*arena, std::move(skipped), isObject,
+                                                                       &parseDeferred, deferredOptions, arena));
+          }
+          else
+          {
+            return Value(details::Payload<details::Deferred>::create(std::move(skipped), isObject,
+                                                                     &parseDeferred, deferredOptions, nullptr));
+          }
+        }
+
+        static Value parseDeferred(const String & text, const void * context, details::Arena * arena)
+        {
+          const ParseOptions & options(*static_cast<const ParseOptions*>(context));
+          if(arena)
+          {
+            // the subtrees of a document may be expanded by several readers
+            std::lock_guard<std::mutex> lock(arena->mutex());
+            Parser p(options, *arena);
+            p.parse(text);
+            return p.takeValue();
+          }
+          Parser p(options);
+          p.parse(text);
+          return p.takeValue();
+        }
+
         void parseArrayBegin(char ch)
         {
           // [
@@ -408,8 +1105,7 @@ namespace surfsara
             {
               if(ch == '"')
               {
-                state.push_back(STRING);
-                value.push_back(Value(std::string("")));
+                beginKey();
               }
               else
               {
@@ -425,8 +1121,7 @@ namespace surfsara
           {
             if(ch == '"')
             {
-              state.push_back(STRING);
-              value.push_back(Value(std::string("")));
+              beginKey();
             }
             else
             {
@@ -440,6 +1135,43 @@ namespace surfsara
           // <NODE>SPACE
           // <NODE>END
           // <NODE>,
+          if(state.back() == ARRAY_END || state.back() == OBJECT_END)
+          {
+            recycler.close(depth, value.back());
+          }
+          if(options.hash)
+          {
+            // children are complete, hash them bottom-up
+            if(state.back() == ARRAY_END)
+            {
+              value.back().as<Array>().cacheHash();
+            }
+            else if(state.back() == OBJECT_END)
+            {
+              value.back().as<Object>().cacheHash();
+            }
+          }
+          if(str == &text && state.back() == STRING_END && !isKey())
+          {
+            finalizeString();
+          }
+          if(options.compact)
+          {
+            compactValue();
+          }
+          if(arena)
+          {
+            dismissCleanup();
+          }
+          if(state.back() == OBJECT_END)
+          {
+            objectDepth--;
+          }
+          if(state.back() == ARRAY_END || state.back() == OBJECT_END)
+          {
+            paths.close(depth);
+            depth--;
+          }
           state.pop_back();
           if(state.back() == BEGIN && (ch == '\0' || isWhiteSpace(ch)))
           {
@@ -448,7 +1180,34 @@ namespace surfsara
           else if(state.back() == ARRAY_BEGIN || state.back() == ARRAY_NEXT)
           {
             assert(value.size() > 1);
-            (value.rbegin() + 1)->as<Array>().pushBack(Node(value.back()));
+            PathMatcher::Action action = paths.action(depth);
+            if(action == PathMatcher::KEEP)
+            {
+              if(options.dedupe)
+              {
+                deduplicator->intern(value.back());
+              }
+              Array & arr((value.rbegin() + 1)->as<Array>());
+              if(Node * old = recycler.element(depth, arr))
+              {
+                *old = Node(std::move(value.back()));
+              }
+              else
+              {
+                arr.pushBack(Node(std::move(value.back())));
+              }
+            }
+            else if(action == PathMatcher::EMIT)
+            {
+              emit();
+            }
+            else if(!callback)
+            {
+              // keeps the indexes of the remaining elements
+              (value.rbegin() + 1)->as<Array>().pushBack(Node(Undefined()));
+            }
+            paths.nextElement(depth);
+            recycler.next(depth);
             value.pop_back();
             if(ch == ',')
             {
@@ -476,6 +1235,7 @@ namespace surfsara
           }
           else if(state.back() == OBJECT_BEGIN || state.back() == OBJECT_NEXT)
           {
+            predictor.learn(objectDepth - 1, keys[objectDepth - 1]);
             if(ch == ':')
             {
               // { "key":
@@ -494,8 +1254,36 @@ namespace surfsara
           else if(state.back() == OBJECT_VALUE)
           {
             assert(value.size() > 1);
-            (value.rbegin() + 2)->as<Object>().set((value.rbegin() + 1)->as<String>(), *value.rbegin());
-            value.pop_back();
+            PathMatcher::Action action = paths.action(depth);
+            if(action == PathMatcher::KEEP)
+            {
+              if(options.dedupe)
+              {
+                deduplicator->intern(value.back());
+              }
+              if(Node * old = recycler.member(depth))
+              {
+                // overwrite the old member with the same key
+                *old = Node(std::move(value.back()));
+              }
+              else
+              {
+                Object & obj((value.rbegin() + 1)->as<Object>());
+                if(options.strings)
+                {
+                  obj.set(predictor.intern(objectDepth - 1, keys[objectDepth - 1]), Node(std::move(value.back())));
+                }
+                else
+                {
+                  obj.set(keys[objectDepth - 1], Node(std::move(value.back())));
+                }
+              }
+            }
+            else if(action == PathMatcher::EMIT)
+            {
+              emit();
+            }
+            recycler.next(depth);
             value.pop_back();
             if(ch == ',')
             {
@@ -532,9 +1320,7 @@ namespace surfsara
 
         inline void parseDigit(char ch)
         {
-          assert(!value.empty());
-          assert(value.back().isA<String>());
-          std::string & res(value.back().as<String>());
+          std::string & res(number);
           
           if(ch >= '0' && ch <= '9')
           {
@@ -559,7 +1345,7 @@ namespace surfsara
 
         inline void parseFracDigit(char ch)
         {
-          std::string & res(value.back().as<String>());
+          std::string & res(number);
           if(ch >= '0' && ch <= '9')
           {
             res.push_back(ch);
@@ -578,7 +1364,7 @@ namespace surfsara
 
         inline void parseExponent(char ch)
         {
-          std::string & res(value.back().as<String>());
+          std::string & res(number);
           if((ch >= '0' && ch <= '9') || ch == '+' || ch == '-')
           {
             res.push_back(ch);
@@ -592,7 +1378,7 @@ namespace surfsara
 
         inline void parseExponentDigit(char ch)
         {
-          std::string & res(value.back().as<String>());
+          std::string & res(number);
           if(ch >= '0' && ch <= '9')
           {
             res.push_back(ch);
@@ -606,117 +1392,336 @@ namespace surfsara
 
         inline void parseString(char ch)
         {
+          if(options.validateUtf8 && !utf8.next(ch))
+          {
+            invalidUtf8(getOffset());
+          }
           if(ch == '\\') state.back() = STRING_ESC;
           else if(ch == '"') state.back() = STRING_END;
-          else value.back().as<String>().push_back(ch);
+          else str->push_back(ch);
+        }
+
+        inline void parseBorrowedString(char ch)
+        {
+          if(options.validateUtf8 && !utf8.next(ch))
+          {
+            invalidUtf8(getOffset());
+          }
+          if(ch == '"')
+          {
+            if(arena)
+            {
+              value.back() = Value(details::Payload<details::BorrowedString>::createIn(*arena, borrowed, cursor - borrowed));
+            }
+            else
+            {
+              value.back() = Value(details::Payload<details::BorrowedString>::create(borrowed, cursor - borrowed));
+            }
+            str = nullptr;
+            state.back() = STRING_END;
+          }
+          else if(ch == '\\')
+          {
+            // escaped strings are decoded while parsing
+            unborrow(cursor);
+            state.back() = STRING_ESC;
+          }
+        }
+
+        /**
+         * continue the borrowed string as a copy,
+         * the text up to end has been consumed
+         */
+        void unborrow(const char * end)
+        {
+          state.back() = STRING;
+          if(options.strings)
+          {
+            text.assign(borrowed, end);
+            str = &text;
+          }
+          else
+          {
+            value.back() = newString();
+            str = &value.back().as<String>();
+            str->assign(borrowed, end);
+          }
         }
 
         inline void parseStringEsc(char ch)
         {
-          std::string & res(value.back().as<String>());
           if(ch == 'u')
           {
-            state.back() = STRING_UNI;
-            value.push_back(Value(std::string("")));
+            beginUniCode();
           }
           else
           {
-            switch(ch)
-            {
-            case '"': res.push_back('"');   break;
-            case '\\': res.push_back('\\'); break;
-            case '/': res.push_back('/');   break;
-            case 'b': res.push_back(0x08);  break;
-            case 'f': res.push_back(0x0c);  break;
-            case 'n': res.push_back('\n');  break;
-            case 'r': res.push_back('\r');  break;
-            case 't': res.push_back('\t');  break;
-            }
+            appendEscaped(ch);
             state.back() = STRING;
           }
         }
 
+        void appendEscaped(char ch)
+        {
+          std::string & res(*str);
+          switch(ch)
+          {
+          case '"': res.push_back('"');   break;
+          case '\\': res.push_back('\\'); break;
+          case '/': res.push_back('/');   break;
+          case 'b': res.push_back(0x08);  break;
+          case 'f': res.push_back(0x0c);  break;
+          case 'n': res.push_back('\n');  break;
+          case 'r': res.push_back('\r');  break;
+          case 't': res.push_back('\t');  break;
+          }
+        }
+
+        void beginUniCode()
+        {
+          state.back() = STRING_UNI;
+          unicode = 0;
+          hexDigits = 0;
+        }
+
+        /**
+         * the hex digits are accumulated in unicode,
+         * a high surrogate waits in highSurrogate for its low half
+         */
         inline void parseStringUniCode(char ch)
         {
-          std::string & res(value.back().as<String>());
-          if((ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F'))
+          int v = hexValue(ch);
+          if(v < 0)
           {
-            res.push_back(ch);
+            invalidUnicode();
           }
-          if(res.size() == 4u)
+          unicode = (unicode << 4) | std::uint32_t(v);
+          if(++hexDigits == 4)
           {
-            std::size_t pos = 0; 
-            std::uint32_t u = std::stoul(res, &pos, 16);
-            value.pop_back();
+            appendUniCode(unicode);
+          }
+        }
+
+        /**
+         * append the code unit of a \u escape, sets the state
+         * that follows it
+         */
+        void appendUniCode(std::uint32_t u)
+        {
+          bool high = (u >= 0xd800 && u <= 0xdbff);
+          bool low = (u >= 0xdc00 && u <= 0xdfff);
+          if(highSurrogate)
+          {
+            if(!low)
+            {
+              invalidUnicode();
+            }
+            appendUtf8(*str, 0x10000 + ((highSurrogate - 0xd800) << 10) + (u - 0xdc00));
+            highSurrogate = 0;
+            state.back() = STRING;
+          }
+          else if(high)
+          {
+            highSurrogate = u;
+            state.back() = STRING_LOW;
+          }
+          else if(low)
+          {
+            invalidUnicode();
+          }
+          else
+          {
+            appendUtf8(*str, u);
             state.back() = STRING;
-            std::string & target(value.back().as<String>());
-            static const uint32_t max_code_point = 0x0010ffffu;
-            static const uint32_t min_lead_surrogate = 0xd800u;
-            static const uint32_t max_lead_surrogate = 0xdbffu;
-            if(u <= max_code_point && (u < min_lead_surrogate || u > max_lead_surrogate))
+          }
+        }
+
+        /**
+         * decode the escape sequences that follow a backslash within a
+         * chunk, including runs of further escapes. Returns the position
+         * after them, incomplete sequences are left to the state machine.
+         */
+        std::size_t scanEscapes(const char * input, std::size_t i, std::size_t n)
+        {
+          while(i < n)
+          {
+            char ch = input[i];
+            if(ch == 'u')
             {
-              if (u < 0x80)
-              {
-                target.push_back((unsigned char)(u));
-              }
-              else if (u < 0x800)
+              long u = (n - i >= 5 ? hexValue4(input + i + 1) : -1);
+              if(u < 0)
               {
-                target.push_back((u >> 6) | 0xc0);
-                target.push_back((u & 0x3f) | 0x80);
+                break;
               }
-              else if (u < 0x10000)
+              if(u >= 0xd800 && u <= 0xdbff)
               {
-                target.push_back((u >> 12) | 0xe0);
-                target.push_back(((u >> 6) & 0x3f) | 0x80);
-                target.push_back((u & 0x3f) | 0x80);
+                // only complete pairs
+                long l = (n - i >= 11 && input[i + 5] == '\\' && input[i + 6] == 'u' ?
+                          hexValue4(input + i + 7) : -1);
+                if(l < 0)
+                {
+                  break;
+                }
+                appendUniCode(std::uint32_t(u));
+                appendUniCode(std::uint32_t(l));
+                i += 11;
               }
               else
               {
-                // four octets
-                target.push_back((u >> 18) | 0xf0);
-                target.push_back(((u >> 12) & 0x3f) | 0x80);
-                target.push_back(((u >> 6) & 0x3f) | 0x80);
-                target.push_back((u & 0x3f) | 0x80);
+                appendUniCode(std::uint32_t(u));
+                i += 5;
               }
             }
+            else if(ch == '"' || ch == '\\' || ch == '/' || ch == 'b' ||
+                    ch == 'f' || ch == 'n' || ch == 'r' || ch == 't')
+            {
+              appendEscaped(ch);
+              state.back() = STRING;
+              i++;
+            }
+            else
+            {
+              break;
+            }
+            // continue with the next escape sequence
+            if(i + 1 < n && input[i] == '\\')
+            {
+              state.back() = STRING_ESC;
+              i++;
+            }
             else
             {
-              throw std::runtime_error(std::string("invalid unicode u") + res);
+              break;
             }
           }
+          return i;
+        }
+
+        void invalidUnicode()
+        {
+          syntaxError("invalid unicode escape");
         }
 
         //////////////////////////////////////
         void parseFloat()
         {
-          std::string & res(value.back().as<String>());
-          long double dvalue = std::stold(res);
-          if(dvalue > std::numeric_limits<Float>::lowest() &&
-             dvalue <= std::numeric_limits<Float>::max())
+          if(options.lazyNumbers)
           {
-            value.pop_back();
-            value.push_back(Value(Float(dvalue)));
+            value.push_back(newRawNumber(true));
           }
           else
           {
-            throw std::out_of_range(std::string("floating point value out of range ") + res);
+            value.push_back(Value(details::toFloat(number)));
           }
         }
 
         void parseInteger()
         {
-          std::string & res(value.back().as<String>());
-          long long ilvalue = std::stoll(res);
-          if(ilvalue > std::numeric_limits<Integer>::min() &&
-             ilvalue <= std::numeric_limits<Integer>::max())
+          if(options.lazyNumbers)
           {
-            value.pop_back();
-            value.push_back(Value(Integer(ilvalue)));
+            value.push_back(newRawNumber(false));
+          }
+          else
+          {
+            value.push_back(Value(details::toInteger(number)));
+          }
+        }
+
+        Value newRawNumber(bool isFloat)
+        {
+          if(arena)
+          {
+            return Value(details::Payload<details::RawNumber>::createIn(*arena, number, isFloat));
           }
           else
           {
-            throw std::out_of_range(std::string("integer value out of range ") + res);
+            return Value(details::Payload<details::RawNumber>::create(number, isFloat));
+          }
+        }
+
+        /**
+         * consume the characters of the string being parsed up to the
+         * next quote, backslash or control character, eight at a time.
+         * Returns the position of that character.
+         */
+        std::size_t scanString(const char * input, std::size_t i, std::size_t n)
+        {
+          std::size_t begin = i;
+          while(n - i >= 8)
+          {
+            std::uint64_t x;
+            std::memcpy(&x, input + i, 8);
+            if(hasStringSpecial(x))
+            {
+              break;
+            }
+            i += 8;
+          }
+          for(; i < n; i++)
+          {
+            unsigned char ch = input[i];
+            if(ch == '"' || ch == '\\' || ch < 0x20)
+            {
+              break;
+            }
+          }
+          if(i == begin)
+          {
+            return i;
+          }
+          if(options.validateUtf8)
+          {
+            const char * bad = utf8.scan(input + begin, input + i);
+            if(bad != input + i)
+            {
+              invalidUtf8(consumed + (bad - chunk));
+            }
+          }
+          if(state.back() == STRING)
+          {
+            str->append(input + begin, i - begin);
+          }
+          return i;
+        }
+
+        /**
+         * move line and col past the characters in [begin, end),
+         * carriage returns do not count as columns
+         */
+        static void advance(const char * begin, const char * end, std::size_t & line, std::size_t & col)
+        {
+          const char * lineBegin = end;
+          while(lineBegin != begin && lineBegin[-1] != '\n')
+          {
+            --lineBegin;
+          }
+          if(lineBegin != begin)
+          {
+            line += std::count(begin, lineBegin, '\n');
+            col = 0;
+          }
+          col += (end - lineBegin) - std::count(lineBegin, end, '\r');
+        }
+
+        /**
+         * line (0) or column (1) including the characters of the
+         * current chunk up to the one being parsed
+         */
+        template<int I>
+        std::size_t currentPos() const
+        {
+          std::size_t l = line;
+          std::size_t c = col;
+          if(cursor)
+          {
+            advance(chunk, cursor + 1, l, c);
           }
+          return I == 0 ? l : c;
+        }
+
+        void invalidUtf8(std::size_t offset)
+        {
+          syntaxError("invalid UTF-8 at offset " + std::to_string(offset));
         }
 
         void unexpectedCharacter(char ch)
@@ -737,23 +1742,135 @@ namespace surfsara
   {
     inline Node parseJson(const std::string & str)
     {
-      detail::Parser p;
+      return parseJson(str, ParseOptions());
+    }
+
+    namespace detail
+    {
+      /**
+       * parser of parseJson() and parseInto(), no user code
+       * runs while parsing, so it is never reentered
+       */
+      inline surfsara::ast::Parser & threadParser(const ParseOptions & options)
+      {
+        static thread_local surfsara::ast::Parser parser;
+        parser.reset(options);
+        return parser;
+      }
+    }
+
+    inline Node parseJson(const std::string & str, const ParseOptions & options)
+    {
+      return detail::threadParser(options).parse(str);
+    }
+
+    inline void parseInto(Node & target, const std::string & str)
+    {
+      parseInto(target, str, ParseOptions());
+    }
+
+    inline void parseInto(Node & target, const std::string & str, const ParseOptions & options)
+    {
+      detail::threadParser(options).parseInto(target, str);
+    }
+
+    inline Node parseJson(const std::string & str, const std::vector<std::string> & paths)
+    {
+      return parseJson(str, paths, ParseOptions());
+    }
+
+    inline Node parseJson(const std::string & str,
+                          const std::vector<std::string> & paths,
+                          const ParseOptions & options)
+    {
+      detail::PathFilter filter(paths);
+      detail::Parser p(options, filter);
       p.parse(str);
-      p.flush();
-      return p.getValue();
+      Node ret(p.takeValue());
+      if(!ret.isA<Array>() && !ret.isA<Object>())
+      {
+        // a path has at least one segment
+        return Node(Undefined());
+      }
+      return ret;
+    }
+
+    template<typename I>
+    inline typename std::enable_if<!std::is_same<I, std::string>::value, Node>::type
+    parseJson(I & begin, const I & end)
+    {
+      return parseJson(begin, end, ParseOptions());
     }
 
     template<typename I>
-    inline Node parseJson(I & begin, const I & end)
+    inline typename std::enable_if<!std::is_same<I, std::string>::value, Node>::type
+    parseJson(I & begin, const I & end, const ParseOptions & options)
     {
-      detail::Parser p;
+      detail::Parser p(options);
       for(I itr = begin; itr != end; ++itr)
       {
         p.parseChar(*itr);
       }
       p.flush();
-      return p.getValue();
+      return Node(p.takeValue());
     }
   } // ast
 
 } // surfsara
+
+inline surfsara::ast::Parser::Parser(const ParseOptions & options)
+  : impl(new detail::Parser(options))
+{
+}
+
+inline surfsara::ast::Parser::~Parser()
+{
+}
+
+inline void surfsara::ast::Parser::reset()
+{
+  impl->reset();
+}
+
+inline void surfsara::ast::Parser::reset(const ParseOptions & options)
+{
+  impl->reset(options);
+}
+
+inline void surfsara::ast::Parser::parseChunk(const char * str, std::size_t n)
+{
+  impl->parseChunk(str, n);
+}
+
+inline surfsara::ast::Node surfsara::ast::Parser::finish()
+{
+  impl->flush();
+  Node ret(impl->takeValue());
+  impl->reset();
+  return ret;
+}
+
+inline surfsara::ast::Node surfsara::ast::Parser::parse(const std::string & str)
+{
+  return parse(str.c_str(), str.size());
+}
+
+inline surfsara::ast::Node surfsara::ast::Parser::parse(const char * str, std::size_t n)
+{
+  impl->reset();
+  impl->parseChunk(str, n);
+  return finish();
+}
+
+inline void surfsara::ast::Parser::parseInto(Node & target, const std::string & str)
+{
+  parseInto(target, str.c_str(), str.size());
+}
+
+inline void surfsara::ast::Parser::parseInto(Node & target, const char * str, std::size_t n)
+{
+  impl->reset();
+  impl->recycle(target.release());
+  impl->parseChunk(str, n);
+  target = finish();
+}
@@ -0,0 +1,973 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <surfsara/json_stream.h>
+#include <surfsara/json_validator.h>
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace detail
+    {
+      // bytes read from a stream at once
+      static const std::size_t streamChunkSize = 64 * 1024;
+
+      /**
+       * stream input is read into a buffer that is reused for the
+       * next chunk, nodes must not reference it
+       */
+      inline ParseOptions streamOptions(const ParseOptions & options)
+      {
+        ParseOptions ret(options);
+        ret.borrow = false;
+        return ret;
+      }
+
+      /**
+       * feed the stream to the parser until it ends or the parser stops
+       */
+      inline void parseStream(Parser & p, std::istream & ist)
+      {
+        std::vector<char> buffer(streamChunkSize);
+        while(!p.isStopped() && ist)
+        {
+          ist.read(buffer.data(), buffer.size());
+          p.parseChunk(buffer.data(), std::size_t(ist.gcount()));
+        }
+        if(!p.isStopped())
+        {
+          p.flush();
+        }
+      }
+    }
+  }
+}
+
+inline std::size_t surfsara::ast::streamFind(std::istream & ist,
+                                             const std::string & path,
+                                             const StreamCallback & callback,
+                                             const ParseOptions & options)
+{
+  std::size_t count = 0;
+  detail::PathFilter filter({path});
+  detail::Parser p(detail::streamOptions(options), filter, [&count, &callback](Node & node, const std::vector<std::string> & realPath){
+      count++;
+      return callback(node, realPath);
+    });
+  detail::parseStream(p, ist);
+  return count;
+}
+
+inline std::size_t surfsara::ast::streamFind(const char * str,
+                                             std::size_t n,
+                                             const std::string & path,
+                                             const StreamCallback & callback,
+                                             const ParseOptions & options)
+{
+  std::size_t count = 0;
+  detail::PathFilter filter({path});
+  detail::Parser p(options, filter, [&count, &callback](Node & node, const std::vector<std::string> & realPath){
+      count++;
+      return callback(node, realPath);
+    });
+  p.parseChunk(str, n);
+  if(!p.isStopped())
+  {
+    p.flush();
+  }
+  return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ArrayReader
+//
+///////////////////////////////////////////////////////////////////////////////
+inline surfsara::ast::ArrayReader::ArrayReader(std::istream & _ist, const ParseOptions & options)
+  : ist(&_ist), buffer(detail::streamChunkSize), data(nullptr), size(0), pos(0),
+    started(false), finished(false), filter({"*"}),
+    parser(detail::streamOptions(options), filter,
+           [this](Node & node, const std::vector<std::string> &){ return callback(node); })
+{
+}
+
+inline surfsara::ast::ArrayReader::ArrayReader(const char * str, std::size_t n, const ParseOptions & options)
+  : ist(nullptr), data(str), size(n), pos(0),
+    started(false), finished(false), filter({"*"}),
+    parser(options, filter,
+           [this](Node & node, const std::vector<std::string> &){ return callback(node); })
+{
+}
+
+inline bool surfsara::ast::ArrayReader::next(Node & node)
+{
+  while(!parser.isStopped() && !finished)
+  {
+    if(pos == size && !fill())
+    {
+      parser.flush();
+      finished = true;
+    }
+    else
+    {
+      if(!started)
+      {
+        while(pos < size && std::isspace(static_cast<unsigned char>(data[pos])))
+        {
+          pos++;
+        }
+        if(pos == size)
+        {
+          continue;
+        }
+        if(data[pos] != '[')
+        {
+          throw std::runtime_error("expected an array");
+        }
+        started = true;
+      }
+      pos += parser.parseChunk(data + pos, size - pos);
+    }
+  }
+  if(parser.isStopped())
+  {
+    parser.resume();
+    node = std::move(current);
+    return true;
+  }
+  return false;
+}
+
+inline surfsara::ast::ArrayReader::iterator surfsara::ast::ArrayReader::begin()
+{
+  return iterator(this);
+}
+
+inline surfsara::ast::ArrayReader::iterator surfsara::ast::ArrayReader::end()
+{
+  return iterator();
+}
+
+inline bool surfsara::ast::ArrayReader::fill()
+{
+  if(ist && *ist)
+  {
+    ist->read(buffer.data(), buffer.size());
+    data = buffer.data();
+    size = std::size_t(ist->gcount());
+    pos = 0;
+    return size > 0;
+  }
+  return false;
+}
+
+inline bool surfsara::ast::ArrayReader::callback(Node & node)
+{
+  // pause the parser until the element is taken
+  current = std::move(node);
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// JsonRewriter
+//
+///////////////////////////////////////////////////////////////////////////////
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace detail
+    {
+      /**
+       * Tokenizes JSON text and copies it to the output, values
+       * matching a rule are skipped and replaced while copying.
+       */
+      class Rewriter
+      {
+      public:
+        Rewriter(const std::vector<JsonRewriter::Rule> & _rules, std::ostream & _ost)
+          : rules(_rules), ost(_ost), state(VALUE), top(0), passWrite(false), passString(false), passEscape(false)
+        {
+        }
+
+        void parseChunk(const char * str, std::size_t n)
+        {
+          std::size_t i = 0;
+          while(i < n)
+          {
+            if(state == PASS)
+            {
+              i += passChunk(str + i, n - i);
+            }
+            else
+            {
+              parseChar(str[i++]);
+            }
+            if(out.size() >= streamChunkSize)
+            {
+              ost.write(out.data(), out.size());
+              out.clear();
+            }
+          }
+        }
+
+        void flush()
+        {
+          if(state == PASS)
+          {
+            // a number at the end of the input
+            if(!checker.finish().valid)
+            {
+              throw std::runtime_error(checker.result().message);
+            }
+            endValue();
+          }
+          if(state != END)
+          {
+            throw std::runtime_error("unexpected end of input");
+          }
+          ost.write(out.data(), out.size());
+          out.clear();
+        }
+
+      private:
+        enum State
+        {
+          VALUE,
+          KEY_BEGIN,
+          KEY,
+          KEY_ESC,
+          COLON,
+          AFTER_VALUE,
+          PASS,
+          END
+        };
+
+        // a rule and its next segment
+        struct Candidate
+        {
+          std::size_t rule;
+          std::size_t pos;
+          // a "*" was matched on the way, insert does not apply
+          bool wild;
+          // the object has a member named by the segment
+          bool seen;
+        };
+
+        // a member that is added at the end of its object
+        struct Member
+        {
+          // the rule that inserted it last
+          std::size_t rule;
+          String name;
+          Node value;
+        };
+
+        struct Frame
+        {
+          bool isObject;
+          std::size_t index;
+          bool written;
+          std::vector<Candidate> candidates;
+          std::vector<Member> appended;
+          // array elements of the input removed by each candidate,
+          // they shift the indexes of the later rules
+          std::vector<std::size_t> removed;
+          // array elements appended by "#", written at the end
+          std::vector<Node> tail;
+        };
+
+        const std::vector<JsonRewriter::Rule> & rules;
+        std::ostream & ost;
+        State state;
+
+        // open containers on the paths of the rules, the
+        // frames above top are kept to reuse their buffers
+        std::vector<Frame> frames;
+        std::size_t top;
+        std::vector<Candidate> next;
+
+        // raw text of the current key
+        String key;
+
+        // checks a value that is copied or skipped
+        JsonValidator checker;
+        bool passWrite;
+        bool passString;
+        bool passEscape;
+
+        String out;
+
+        void unexpectedCharacter(char ch)
+        {
+          throw std::runtime_error(std::string("unexpected character '") + ch + std::string("'"));
+        }
+
+        void parseChar(char ch)
+        {
+          switch(state)
+          {
+          case VALUE:
+            if(isWhiteSpace(ch))
+            {
+              break;
+            }
+            else if(ch == ']' && top > 0 && !frames[top - 1].isObject && frames[top - 1].index == 0)
+            {
+              // []
+              closeFrame();
+            }
+            else
+            {
+              beginValue(ch);
+            }
+            break;
+          case KEY_BEGIN:
+            if(ch == '"')
+            {
+              key.clear();
+              state = KEY;
+            }
+            else if(ch == '}' && frames[top - 1].index == 0)
+            {
+              // {}
+              closeFrame();
+            }
+            else if(!isWhiteSpace(ch))
+            {
+              unexpectedCharacter(ch);
+            }
+            break;
+          case KEY:
+            if(ch == '"')
+            {
+              state = COLON;
+            }
+            else if(ch == '\\')
+            {
+              state = KEY_ESC;
+            }
+            else
+            {
+              key.push_back(ch);
+            }
+            break;
+          case KEY_ESC:
+            if(isEscape(ch))
+            {
+              key.push_back('\\');
+              key.push_back(ch);
+            }
+            state = KEY;
+            break;
+          case COLON:
+            if(ch == ':')
+            {
+              state = VALUE;
+            }
+            else if(!isWhiteSpace(ch))
+            {
+              unexpectedCharacter(ch);
+            }
+            break;
+          case AFTER_VALUE:
+            if(ch == ',')
+            {
+              state = (frames[top - 1].isObject ? KEY_BEGIN : VALUE);
+            }
+            else if(ch == (frames[top - 1].isObject ? '}' : ']'))
+            {
+              closeFrame();
+            }
+            else if(!isWhiteSpace(ch))
+            {
+              unexpectedCharacter(ch);
+            }
+            break;
+          case PASS:
+            passChunk(&ch, 1);
+            break;
+          case END:
+            if(!isWhiteSpace(ch))
+            {
+              unexpectedCharacter(ch);
+            }
+            break;
+          }
+        }
+
+        void endValue()
+        {
+          state = (top == 0 ? END : AFTER_VALUE);
+        }
+
+        /**
+         * decide what happens to the value starting with ch
+         */
+        void beginValue(char ch)
+        {
+          // once a rule replaces or removes the value, the later
+          // rules are applied to the replacement
+          bool materialized = false;
+          bool present = true;
+          // removed and inserted again, Node::update() appends it
+          bool moved = false;
+          std::size_t insertedBy = 0;
+          Node value;
+          String name;
+          next.clear();
+          if(top == 0)
+          {
+            for(std::size_t i = 0; i < rules.size(); i++)
+            {
+              next.push_back(Candidate{i, 0, false, false});
+            }
+          }
+          else
+          {
+            Frame & parent(frames[top - 1]);
+            if(parent.isObject)
+            {
+              name = decodeKey();
+            }
+            // elements before this one removed by the earlier rules
+            std::size_t shift = 0;
+            std::size_t removedBy = parent.candidates.size();
+            for(std::size_t i = 0; i < parent.candidates.size(); i++)
+            {
+              Candidate & c(parent.candidates[i]);
+              const JsonRewriter::Rule & rule(rules[c.rule]);
+              const std::string & segment(rule.path[c.pos]);
+              bool hit = (segment == "*");
+              if(parent.isObject && segment == name)
+              {
+                c.seen = true;
+                hit = true;
+              }
+              else if(!parent.isObject)
+              {
+                std::size_t position = parent.index - shift;
+                shift += parent.removed[i];
+                if(!present)
+                {
+                  // the later rules do not see a removed element
+                  continue;
+                }
+                hit = hit || isIndex(segment, position);
+              }
+              if(!hit)
+              {
+                continue;
+              }
+              else if(materialized || c.pos + 1 == rule.path.size())
+              {
+                if(!materialized)
+                {
+                  // earlier rules below this value are overwritten
+                  next.clear();
+                  materialized = true;
+                }
+                if(apply(c, parent.isObject, value, present))
+                {
+                  moved = parent.isObject;
+                  insertedBy = c.rule;
+                }
+                if(!parent.isObject && !present)
+                {
+                  removedBy = i;
+                }
+              }
+              else
+              {
+                next.push_back(Candidate{c.rule, c.pos + 1, c.wild || segment == "*", false});
+              }
+            }
+            if(removedBy < parent.candidates.size())
+            {
+              parent.removed[removedBy]++;
+            }
+            parent.index++;
+          }
+          if(!materialized)
+          {
+            writeSeparator();
+            if((ch == '[' || ch == '{') && !next.empty())
+            {
+              openFrame(ch == '{');
+            }
+            else
+            {
+              for(const Candidate & c : next)
+              {
+                if(!c.wild)
+                {
+                  // Node::update() and Node::remove() reject the path
+                  const JsonRewriter::Rule & rule(rules[c.rule]);
+                  throw PathError(rule.path, std::string(rule.remove ? "Could remove " : "Could update ") +
+                                  rule.path[c.pos] + " in a value that is not an array or object");
+                }
+              }
+              pass(ch, true);
+            }
+          }
+          else if(moved && present)
+          {
+            frames[top - 1].appended.push_back(Member{insertedBy, name, std::move(value)});
+            pass(ch, false);
+          }
+          else if(present)
+          {
+            writeSeparator();
+            out += formatJson(value);
+            pass(ch, false);
+          }
+          else
+          {
+            pass(ch, false);
+          }
+        }
+
+        /**
+         * apply the rule of c to a value held in memory, present is
+         * false if the value was removed or is a missing member, same
+         * as Node::update() and Node::remove() on the parent. Returns
+         * true if the rule inserted the value.
+         */
+        bool apply(const Candidate & c, bool isObject, Node & value, bool & present) const
+        {
+          const JsonRewriter::Rule & rule(rules[c.rule]);
+          // a "*" only matches existing values
+          bool insert = rule.insert && !c.wild && rule.path[c.pos] != "*";
+          bool inserted = false;
+          if(c.pos + 1 == rule.path.size())
+          {
+            if(rule.remove)
+            {
+              present = false;
+            }
+            else if(present || insert)
+            {
+              inserted = !present;
+              value = rule.value;
+              present = true;
+            }
+          }
+          else if(present)
+          {
+            std::vector<std::string> path(rule.path.begin() + c.pos + 1, rule.path.end());
+            try
+            {
+              if(rule.remove)
+              {
+                value.remove(path);
+              }
+              else
+              {
+                value.update(path, rule.value, insert);
+              }
+            }
+            catch(const PathError &)
+            {
+              // below a "*" paths that do not fit are ignored
+              if(!c.wild)
+              {
+                throw;
+              }
+            }
+          }
+          else if(isObject && insert && !rule.remove)
+          {
+            value = nodeFromPath(rule.path, rule.value, c.pos + 1);
+            inserted = true;
+            present = true;
+          }
+          return inserted;
+        }
+
+        String decodeKey() const
+        {
+          if(key.find('\\') == String::npos)
+          {
+            return key;
+          }
+          return parseJson("\"" + key + "\"").as<String>();
+        }
+
+        static bool isNumber(const std::string & segment)
+        {
+          return (!segment.empty() && segment.find_first_not_of("0123456789") == std::string::npos);
+        }
+
+        static bool isIndex(const std::string & segment, std::size_t index)
+        {
+          return isNumber(segment) && std::stoull(segment) == index;
+        }
+
+        void writeSeparator()
+        {
+          if(top > 0)
+          {
+            Frame & parent(frames[top - 1]);
+            if(parent.written)
+            {
+              out.push_back(',');
+            }
+            parent.written = true;
+            if(parent.isObject)
+            {
+              out.push_back('"');
+              out += key;
+              out += "\":";
+            }
+          }
+        }
+
+        /**
+         * copy (write) or skip the value starting with ch
+         */
+        void pass(char ch, bool write)
+        {
+          passWrite = write;
+          passString = false;
+          passEscape = false;
+          checker.reset();
+          state = PASS;
+          passChunk(&ch, 1);
+        }
+
+        /**
+         * check the next part of the passed value, returns the number
+         * of characters that belong to it
+         */
+        std::size_t passChunk(const char * str, std::size_t n)
+        {
+          std::size_t len = checker.feedValue(str, n);
+          if(!checker.result().valid)
+          {
+            throw std::runtime_error(checker.result().message);
+          }
+          if(passWrite)
+          {
+            copy(str, len);
+          }
+          if(checker.complete())
+          {
+            endValue();
+          }
+          return len;
+        }
+
+        /**
+         * append checked text without the white space between
+         * tokens and without the escapes the parser drops
+         */
+        void copy(const char * str, std::size_t n)
+        {
+          for(std::size_t i = 0; i < n; i++)
+          {
+            char ch = str[i];
+            if(passEscape)
+            {
+              passEscape = false;
+              if(isEscape(ch))
+              {
+                out.push_back('\\');
+                out.push_back(ch);
+              }
+              continue;
+            }
+            else if(passString)
+            {
+              if(ch == '\\')
+              {
+                passEscape = true;
+                continue;
+              }
+              else if(ch == '"')
+              {
+                passString = false;
+              }
+            }
+            else if(ch == '"')
+            {
+              passString = true;
+            }
+            else if(isWhiteSpace(ch))
+            {
+              continue;
+            }
+            out.push_back(ch);
+          }
+        }
+
+        void openFrame(bool isObject)
+        {
+          if(frames.size() == top)
+          {
+            frames.push_back(Frame());
+          }
+          Frame & frame(frames[top++]);
+          frame.isObject = isObject;
+          frame.index = 0;
+          frame.written = false;
+          frame.candidates.swap(next);
+          frame.appended.clear();
+          frame.removed.assign(frame.candidates.size(), 0);
+          frame.tail.clear();
+          if(!isObject)
+          {
+            for(const Candidate & c : frame.candidates)
+            {
+              const JsonRewriter::Rule & rule(rules[c.rule]);
+              const std::string & segment(rule.path[c.pos]);
+              if(!isNumber(segment) && segment != "*" && !(segment == "#" && rule.insert && !rule.remove))
+              {
+                throw PathError(rule.path, "Invalid array index " + segment);
+              }
+            }
+          }
+          out.push_back(isObject ? '{' : '[');
+          state = (isObject ? KEY_BEGIN : VALUE);
+        }
+
+        void closeFrame()
+        {
+          Frame & frame(frames[top - 1]);
+          for(std::size_t i = 0; i < frame.candidates.size(); i++)
+          {
+            const Candidate & c(frame.candidates[i]);
+            const JsonRewriter::Rule & rule(rules[c.rule]);
+            if(rule.remove || !rule.insert)
+            {
+              continue;
+            }
+            const std::string & segment(rule.path[c.pos]);
+            if(frame.isObject && !c.wild && !c.seen && segment != "*" && !isInsertedBefore(frame, i))
+            {
+              // the first rule that inserts the member, the
+              // later rules are applied to what it inserts
+              Member member{c.rule, segment, Node()};
+              bool present = false;
+              for(std::size_t j = i; j < frame.candidates.size(); j++)
+              {
+                const Candidate & other(frame.candidates[j]);
+                const std::string & otherSegment(rules[other.rule].path[other.pos]);
+                if((otherSegment == segment || otherSegment == "*") &&
+                   apply(other, true, member.value, present))
+                {
+                  member.rule = other.rule;
+                }
+              }
+              if(present)
+              {
+                frame.appended.push_back(std::move(member));
+              }
+            }
+          }
+          if(!frame.isObject)
+          {
+            appendElements(frame);
+          }
+          // in the order Node::update() would add them
+          std::stable_sort(frame.appended.begin(), frame.appended.end(),
+                           [](const Member & a, const Member & b) { return a.rule < b.rule; });
+          for(const Member & member : frame.appended)
+          {
+            if(frame.written)
+            {
+              out.push_back(',');
+            }
+            frame.written = true;
+            out += formatJson(Node(member.name));
+            out.push_back(':');
+            out += formatJson(member.value);
+          }
+          frame.appended.clear();
+          out.push_back(frame.isObject ? '}' : ']');
+          top--;
+          endValue();
+        }
+
+        /**
+         * apply the rules in order to the elements appended by "#",
+         * an index past the end of the array throws like Node::update()
+         */
+        void appendElements(Frame & frame)
+        {
+          // elements of the input left when the rule is applied
+          std::size_t remaining = frame.index;
+          for(std::size_t i = 0; i < frame.candidates.size(); i++)
+          {
+            const Candidate & c(frame.candidates[i]);
+            const JsonRewriter::Rule & rule(rules[c.rule]);
+            const std::string & segment(rule.path[c.pos]);
+            std::size_t base = remaining;
+            remaining -= frame.removed[i];
+            if(segment == "#")
+            {
+              frame.tail.push_back(nodeFromPath(rule.path, rule.value, c.pos + 1));
+            }
+            else if(segment == "*")
+            {
+              Candidate each{c.rule, c.pos, true, false};
+              for(std::size_t t = 0; t < frame.tail.size();)
+              {
+                bool present = true;
+                apply(each, false, frame.tail[t], present);
+                if(present)
+                {
+                  t++;
+                }
+                else
+                {
+                  frame.tail.erase(frame.tail.begin() + t);
+                }
+              }
+            }
+            else
+            {
+              std::size_t index = std::stoull(segment);
+              if(index < base)
+              {
+                // an element of the input
+                continue;
+              }
+              else if(index - base < frame.tail.size())
+              {
+                bool present = true;
+                apply(c, false, frame.tail[index - base], present);
+                if(!present)
+                {
+                  frame.tail.erase(frame.tail.begin() + (index - base));
+                }
+              }
+              else if(!rule.remove)
+              {
+                throw PathError(rule.path, "Index out of range " + segment);
+              }
+            }
+          }
+          for(const Node & node : frame.tail)
+          {
+            if(frame.written)
+            {
+              out.push_back(',');
+            }
+            frame.written = true;
+            out += formatJson(node);
+          }
+          frame.tail.clear();
+        }
+
+        /**
+         * an earlier rule already inserts the same member
+         */
+        bool isInsertedBefore(const Frame & frame, std::size_t i) const
+        {
+          const std::string & segment(rules[frame.candidates[i].rule].path[frame.candidates[i].pos]);
+          for(std::size_t j = 0; j < i; j++)
+          {
+            const Candidate & other(frame.candidates[j]);
+            const JsonRewriter::Rule & rule(rules[other.rule]);
+            if(rule.insert && !rule.remove && !other.wild && rule.path[other.pos] == segment)
+            {
+              return true;
+            }
+          }
+          return false;
+        }
+
+        /**
+         * same as Node::nodeFromPath()
+         */
+        static Node nodeFromPath(const std::vector<std::string> & path, const Node & node, std::size_t pos)
+        {
+          if(pos < path.size())
+          {
+            if(path[pos] == "#")
+            {
+              return Array{nodeFromPath(path, node, pos + 1)};
+            }
+            else
+            {
+              return Object{Pair{path[pos], nodeFromPath(path, node, pos + 1)}};
+            }
+          }
+          return node;
+        }
+      };
+    }
+  }
+}
+
+inline surfsara::ast::JsonRewriter & surfsara::ast::JsonRewriter::update(const std::string & path,
+                                                                          const Node & value,
+                                                                          bool insert)
+{
+  rules.push_back(Rule{details::split(path, "/"), false, value, insert});
+  return *this;
+}
+
+inline surfsara::ast::JsonRewriter & surfsara::ast::JsonRewriter::remove(const std::string & path)
+{
+  rules.push_back(Rule{details::split(path, "/"), true, Node(), false});
+  return *this;
+}
+
+inline void surfsara::ast::JsonRewriter::rewrite(std::istream & ist, std::ostream & ost) const
+{
+  detail::Rewriter rewriter(rules, ost);
+  std::vector<char> buffer(detail::streamChunkSize);
+  while(ist)
+  {
+    ist.read(buffer.data(), buffer.size());
+    rewriter.parseChunk(buffer.data(), std::size_t(ist.gcount()));
+  }
+  rewriter.flush();
+}
+
+inline void surfsara::ast::JsonRewriter::rewrite(const char * str, std::size_t n, std::ostream & ost) const
+{
+  detail::Rewriter rewriter(rules, ost);
+  rewriter.parseChunk(str, n);
+  rewriter.flush();
+}
+
+inline std::string surfsara::ast::JsonRewriter::rewrite(const std::string & str) const
+{
+  std::stringstream ss;
+  rewrite(str.c_str(), str.size(), ss);
+  return ss.str();
+}
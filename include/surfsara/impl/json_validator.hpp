@@ -0,0 +1,492 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <surfsara/json_validator.h>
+#include <surfsara/ast.h>
+#include <surfsara/impl/scan.hpp>
+#include <cstring>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace detail
+    {
+      /**
+       * true if the parser converts the text of a number, which has
+       * the syntax accepted by its number states. Numbers that are
+       * short enough to be in range are not converted.
+       */
+      inline bool isNumber(const char * begin, const char * end, bool isFloat)
+      {
+        if(!isFloat && end - begin <= 18)
+        {
+          // digits, maybe after a sign
+          return end - begin > 1 || isDigit(*begin);
+        }
+        const char * mantissa = begin;
+        std::size_t digits = 0;
+        while(mantissa != end && *mantissa != 'e' && *mantissa != 'E')
+        {
+          digits += (isDigit(*mantissa) ? 1 : 0);
+          ++mantissa;
+        }
+        if(digits == 0)
+        {
+          return false;
+        }
+        if(!isFloat ? digits <= 18 :
+           mantissa - begin <= 20 && (mantissa == end || end - mantissa <= 3))
+        {
+          return true;
+        }
+        try
+        {
+          String text(begin, end);
+          if(isFloat)
+          {
+            details::toFloat(text);
+          }
+          else
+          {
+            details::toInteger(text);
+          }
+          return true;
+        }
+        catch(const std::exception &)
+        {
+          return false;
+        }
+      }
+    }
+  }
+}
+
+inline surfsara::ast::JsonValidator::JsonValidator()
+{
+  reset();
+}
+
+inline void surfsara::ast::JsonValidator::reset()
+{
+  state = VALUE;
+  inKey = false;
+  lowPending = false;
+  literal = nullptr;
+  hexCount = 0;
+  code = 0;
+  offset = 0;
+  depth = 0;
+  deepContainers.clear();
+  number.clear();
+  numberStart = 0;
+  error = ValidationResult{true, 0, nullptr};
+}
+
+inline bool surfsara::ast::JsonValidator::feed(const char * str, std::size_t n)
+{
+  check<false>(str, n);
+  return state != ERROR;
+}
+
+inline std::size_t surfsara::ast::JsonValidator::feedValue(const char * str, std::size_t n)
+{
+  return check<true>(str, n);
+}
+
+inline bool surfsara::ast::JsonValidator::complete() const
+{
+  return state == AFTER && depth == 0;
+}
+
+inline const surfsara::ast::ValidationResult & surfsara::ast::JsonValidator::result() const
+{
+  return error;
+}
+
+template<bool SINGLE>
+inline std::size_t surfsara::ast::JsonValidator::check(const char * str, std::size_t n)
+{
+  std::size_t i = 0;
+  numberStart = 0;
+  while(i < n && state != ERROR && !(SINGLE && complete()))
+  {
+    char ch = str[i];
+    switch(state)
+    {
+    case VALUE:
+      if(detail::isWhiteSpace(ch)) i++;
+      else i = beginValue(str, i);
+      break;
+    case ARRAY_FIRST:
+      if(detail::isWhiteSpace(ch)) i++;
+      else if(ch == ']') pop(false, i++);
+      else i = beginValue(str, i);
+      break;
+    case OBJECT_FIRST:
+    case KEY:
+      if(detail::isWhiteSpace(ch))
+      {
+        i++;
+      }
+      else if(ch == '"')
+      {
+        state = STRING;
+        inKey = true;
+        i++;
+      }
+      else if(ch == '}' && state == OBJECT_FIRST)
+      {
+        pop(true, i++);
+      }
+      else
+      {
+        fail("expected key", i);
+      }
+      break;
+    case COLON:
+      if(detail::isWhiteSpace(ch)) i++;
+      else if(ch == ':') { state = VALUE; i++; }
+      else fail("expected ':'", i);
+      break;
+    case AFTER:
+      if(detail::isWhiteSpace(ch))
+      {
+        i++;
+      }
+      else if(depth == 0)
+      {
+        // the parser marks the end of the input with a null character
+        if(ch == '\0') i++;
+        else fail("unexpected character after the document", i);
+      }
+      else if(ch == ',')
+      {
+        state = (isObject(depth - 1) ? KEY : VALUE);
+        i++;
+      }
+      else if(ch == ']' || ch == '}')
+      {
+        pop(ch == '}', i++);
+      }
+      else
+      {
+        fail("expected ',' or closing bracket", i);
+      }
+      break;
+    case STRING:
+      i = scanString(str, i, n);
+      if(i == n)
+      {
+        break;
+      }
+      ch = str[i];
+      if(ch == '"')
+      {
+        state = (inKey ? COLON : AFTER);
+      }
+      else if(ch == '\\')
+      {
+        state = STRING_ESC;
+      }
+      // control characters are kept by the parser
+      i++;
+      break;
+    case STRING_ESC:
+      if(ch == 'u')
+      {
+        state = STRING_HEX;
+        hexCount = 0;
+        code = 0;
+      }
+      else
+      {
+        // the parser drops unknown escapes
+        state = STRING;
+      }
+      i++;
+      break;
+    case STRING_HEX:
+      {
+        int v = detail::hexValue(ch);
+        if(v < 0)
+        {
+          fail("invalid unicode escape", i);
+          break;
+        }
+        code = code * 16 + v;
+        i++;
+        if(++hexCount < 4)
+        {
+          break;
+        }
+        bool high = (code >= 0xd800 && code <= 0xdbff);
+        bool low = (code >= 0xdc00 && code <= 0xdfff);
+        if(lowPending ? !low : low)
+        {
+          fail("unpaired surrogate", i - 4);
+        }
+        else
+        {
+          lowPending = high;
+          state = (high ? STRING_LOW : STRING);
+        }
+      }
+      break;
+    case STRING_LOW:
+      if(ch == '\\') { state = STRING_LOW_U; i++; }
+      else fail("unpaired surrogate", i);
+      break;
+    case STRING_LOW_U:
+      if(ch == 'u') { state = STRING_HEX; hexCount = 0; code = 0; i++; }
+      else fail("unpaired surrogate", i);
+      break;
+    case LITERAL:
+      if(ch != *literal)
+      {
+        fail("invalid literal", i);
+        break;
+      }
+      i++;
+      if(*++literal == '\0')
+      {
+        state = AFTER;
+      }
+      break;
+    case NUM_DIGIT:
+    case NUM_FRAC:
+    case NUM_EXP_DIGIT:
+      while(i < n && detail::isDigit(str[i]))
+      {
+        i++;
+      }
+      if(i == n)
+      {
+        break;
+      }
+      ch = str[i];
+      if(ch == '.' && state == NUM_DIGIT)
+      {
+        state = NUM_FRAC;
+        i++;
+      }
+      else if((ch == 'e' || ch == 'E') && state != NUM_EXP_DIGIT)
+      {
+        state = NUM_EXP;
+        i++;
+      }
+      else
+      {
+        // the character is checked by AFTER
+        endNumber(str, i, state != NUM_DIGIT);
+      }
+      break;
+    case NUM_EXP:
+      if(detail::isDigit(ch) || ch == '+' || ch == '-') { state = NUM_EXP_DIGIT; i++; }
+      else fail("invalid number", i);
+      break;
+    case ERROR:
+      break;
+    }
+  }
+  if(state == NUM_DIGIT || state == NUM_FRAC || state == NUM_EXP || state == NUM_EXP_DIGIT)
+  {
+    number.append(str + numberStart, i - numberStart);
+  }
+  if(state != ERROR)
+  {
+    offset += i;
+  }
+  return i;
+}
+
+inline surfsara::ast::ValidationResult surfsara::ast::JsonValidator::finish()
+{
+  if(state == NUM_DIGIT || state == NUM_FRAC || state == NUM_EXP_DIGIT)
+  {
+    numberStart = 0;
+    endNumber("", 0, state != NUM_DIGIT);
+  }
+  if(state != ERROR && !complete())
+  {
+    fail("unexpected end of input", 0);
+  }
+  return error;
+}
+
+inline std::size_t surfsara::ast::JsonValidator::beginValue(const char * str, std::size_t i)
+{
+  switch(str[i])
+  {
+  case '"':
+    state = STRING;
+    inKey = false;
+    break;
+  case '[':
+    push(false);
+    break;
+  case '{':
+    push(true);
+    break;
+  case 't':
+    state = LITERAL;
+    literal = "rue";
+    break;
+  case 'f':
+    state = LITERAL;
+    literal = "alse";
+    break;
+  case 'n':
+    state = LITERAL;
+    literal = "ull";
+    break;
+  case '.':
+    state = NUM_FRAC;
+    break;
+  case '-':
+  case '+':
+    state = NUM_DIGIT;
+    break;
+  default:
+    if(detail::isDigit(str[i]))
+    {
+      state = NUM_DIGIT;
+    }
+    else
+    {
+      fail("unexpected character", i);
+    }
+  }
+  // number is empty, it only holds the part of a split number
+  numberStart = i;
+  return i + 1;
+}
+
+inline std::size_t surfsara::ast::JsonValidator::scanString(const char * str, std::size_t i, std::size_t n) const
+{
+  while(n - i >= 8)
+  {
+    std::uint64_t x;
+    std::memcpy(&x, str + i, 8);
+    if(detail::hasStringSpecial(x))
+    {
+      break;
+    }
+    i += 8;
+  }
+  for(; i < n; i++)
+  {
+    unsigned char ch = str[i];
+    if(ch == '"' || ch == '\\' || ch < 0x20)
+    {
+      break;
+    }
+  }
+  return i;
+}
+
+inline void surfsara::ast::JsonValidator::endNumber(const char * str, std::size_t i, bool isFloat)
+{
+  const char * begin = str + numberStart;
+  const char * end = str + i;
+  if(!number.empty())
+  {
+    // started in a previous chunk
+    number.append(begin, end);
+    begin = number.data();
+    end = begin + number.size();
+  }
+  if(detail::isNumber(begin, end, isFloat))
+  {
+    state = AFTER;
+  }
+  else
+  {
+    fail("invalid number", i);
+  }
+  number.clear();
+}
+
+inline void surfsara::ast::JsonValidator::push(bool isObject)
+{
+  std::size_t word = depth / 64;
+  if(word >= 64 && deepContainers.size() <= word - 64)
+  {
+    deepContainers.push_back(0);
+  }
+  std::uint64_t & bits(word < 64 ? containers[word] : deepContainers[word - 64]);
+  std::uint64_t bit = std::uint64_t(1) << (depth % 64);
+  if(isObject)
+  {
+    bits |= bit;
+  }
+  else
+  {
+    bits &= ~bit;
+  }
+  depth++;
+  state = (isObject ? OBJECT_FIRST : ARRAY_FIRST);
+}
+
+inline void surfsara::ast::JsonValidator::pop(bool object, std::size_t i)
+{
+  if(isObject(depth - 1) != object)
+  {
+    fail("mismatched bracket", i);
+    return;
+  }
+  depth--;
+  state = AFTER;
+}
+
+inline bool surfsara::ast::JsonValidator::isObject(std::size_t d) const
+{
+  std::size_t word = d / 64;
+  std::uint64_t bits = (word < 64 ? containers[word] : deepContainers[word - 64]);
+  return (bits >> (d % 64)) & 1u;
+}
+
+inline void surfsara::ast::JsonValidator::fail(const char * msg, std::size_t i)
+{
+  state = ERROR;
+  error = ValidationResult{false, offset + i, msg};
+}
+
+inline surfsara::ast::ValidationResult surfsara::ast::validateJson(const char * str, std::size_t n)
+{
+  JsonValidator validator;
+  validator.feed(str, n);
+  return validator.finish();
+}
+
+inline surfsara::ast::ValidationResult surfsara::ast::validateJson(const std::string & str)
+{
+  return validateJson(str.c_str(), str.size());
+}
@@ -0,0 +1,282 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <surfsara/ast.h>
+#include <surfsara/string_pool.h>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace detail
+    {
+      /**
+       * for each object depth the keys of the last object at that depth,
+       * kept across documents. A key that matches the prediction is
+       * consumed with one memcmp instead of the state machine.
+       * Only the first maxLearnedKeys keys of up to maxLearnedKeySize
+       * bytes are kept, so a huge object does not stay in memory.
+       */
+      class KeyPredictor
+      {
+      public:
+        static const std::size_t maxLearnedKeys = 64;
+        static const std::size_t maxLearnedKeySize = 256;
+
+        KeyPredictor()
+          : enabled(true), validateUtf8(false), strings(nullptr), predicting(false), predicted(false)
+        {
+        }
+
+        /**
+         * a disabled predictor neither learns nor predicts keys,
+         * keys are interned from strings if it is set
+         */
+        void configure(bool _enabled, bool _validateUtf8, StringPool * _strings)
+        {
+          enabled = _enabled;
+          validateUtf8 = _validateUtf8;
+          strings = _strings;
+          if(!enabled)
+          {
+            std::vector<Shape>().swap(shapes);
+          }
+        }
+
+        void reset()
+        {
+          predicting = false;
+          predicted = false;
+        }
+
+        /**
+         * an object begins at the (zero based) object depth
+         */
+        void enterObject(std::size_t depth)
+        {
+          if(!enabled)
+          {
+            return;
+          }
+          if(shapes.size() <= depth)
+          {
+            shapes.resize(depth + 1);
+          }
+          shapes[depth].next = 0;
+        }
+
+        /**
+         * a key begins in the object at depth, it is predicted
+         * if the rest of it is in a contiguous input
+         */
+        void beginKey(std::size_t depth, bool contiguous)
+        {
+          if(!enabled || !contiguous)
+          {
+            return;
+          }
+          const Shape & shape(shapes[depth]);
+          predicting = (shape.next < shape.keys.size() &&
+                        (shape.predictable[shape.next] == ALWAYS ||
+                         (shape.predictable[shape.next] == UNVALIDATED && !validateUtf8)));
+        }
+
+        /**
+         * true if the key that began is to be predicted
+         */
+        bool pending() const
+        {
+          return predicting;
+        }
+
+        /**
+         * consume the rest of the key if it is the key of the previous
+         * object at the same position, on success the key is assigned
+         * and i is advanced past its closing quote
+         */
+        bool predict(std::size_t depth, const char * input, std::size_t & i, std::size_t n, String & key)
+        {
+          predicting = false;
+          const Shape & shape(shapes[depth]);
+          const String & expected(shape.keys[shape.next]);
+          std::size_t len = expected.size();
+          if(n - i > len && input[i + len] == '"' && std::memcmp(input + i, expected.data(), len) == 0)
+          {
+            key.assign(expected);
+            predicted = true;
+            i += len + 1;
+            return true;
+          }
+          return false;
+        }
+
+        /**
+         * remember the completed key for the next object at this depth
+         */
+        void learn(std::size_t depth, const String & key)
+        {
+          if(!enabled)
+          {
+            return;
+          }
+          Shape & shape(shapes[depth]);
+          if(predicted)
+          {
+            predicted = false;
+          }
+          else
+          {
+            // long keys only occupy their position
+            bool keep = key.size() <= maxLearnedKeySize;
+            // the raw text of such keys differs from the decoded one,
+            // non-ASCII keys are not predicted while validating UTF-8
+            char predictable = (!keep || key.find_first_of("\"\\\n") != String::npos ? NEVER :
+                                isAscii(key) ? ALWAYS : UNVALIDATED);
+            if(shape.next < shape.keys.size())
+            {
+              if(shape.predictable[shape.next] != predictable || (keep && shape.keys[shape.next] != key))
+              {
+                shape.keys[shape.next].assign(keep ? key.data() : "", keep ? key.size() : 0);
+                shape.predictable[shape.next] = predictable;
+              }
+            }
+            else if(shape.keys.size() < maxLearnedKeys)
+            {
+              shape.keys.push_back(keep ? key : String());
+              shape.predictable.push_back(predictable);
+            }
+          }
+          shape.next++;
+        }
+
+        /**
+         * the completed key from the string pool, learn() has
+         * already advanced the shape past its position
+         */
+        Key intern(std::size_t depth, const String & key)
+        {
+          if(!enabled)
+          {
+            return strings->key(key);
+          }
+          Shape & shape(shapes[depth]);
+          std::size_t pos = shape.next - 1;
+          if(pos < shape.interned.size())
+          {
+            if(shape.interned[pos].str() != key)
+            {
+              shape.interned[pos] = strings->key(key);
+            }
+            return shape.interned[pos];
+          }
+          if(pos == shape.interned.size() && pos < maxLearnedKeys)
+          {
+            shape.interned.push_back(strings->key(key));
+            return shape.interned.back();
+          }
+          return strings->key(key);
+        }
+
+        /**
+         * number of keys remembered for prediction
+         */
+        std::size_t learnedKeys() const
+        {
+          std::size_t n = 0;
+          for(const Shape & shape : shapes)
+          {
+            n += shape.keys.size();
+          }
+          return n;
+        }
+
+        std::size_t retainedBytes() const
+        {
+          return shapes.capacity() * sizeof(Shape);
+        }
+
+        /**
+         * forget the shapes if objects were nested deeper than maxDepth
+         */
+        void shrink(std::size_t maxDepth)
+        {
+          if(shapes.capacity() > maxDepth)
+          {
+            std::vector<Shape>().swap(shapes);
+          }
+        }
+
+      private:
+        struct Shape
+        {
+          Shape() : next(0)
+          {
+          }
+
+          std::vector<String> keys;
+          std::vector<char> predictable;
+          std::size_t next;
+          // keys from the string pool by position, so that a
+          // repeated key takes neither the pool lock nor a hash
+          std::vector<Key> interned;
+        };
+
+        enum Predictable : char
+        {
+          NEVER,
+          ALWAYS,
+          UNVALIDATED
+        };
+
+        bool enabled;
+        bool validateUtf8;
+        StringPool * strings;
+        std::vector<Shape> shapes;
+        bool predicting;
+        bool predicted;
+
+        static bool isAscii(const String & key)
+        {
+          for(char ch : key)
+          {
+            if(static_cast<unsigned char>(ch) >= 0x80)
+            {
+              return false;
+            }
+          }
+          return true;
+        }
+      };
+    }
+  }
+}
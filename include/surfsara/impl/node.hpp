@@ -29,6 +29,13 @@ SOFTWARE.
 /////////////////////////////////////////////////////
 #include <sstream>
 #include <iostream>
+#include <atomic>
+#include <cassert>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
 namespace surfsara
 {
   namespace ast
@@ -52,6 +59,389 @@ namespace surfsara
                                     inp.end()));
         return ret;
       }
+
+      inline ::std::size_t hashCombine(::std::size_t seed, ::std::size_t value)
+      {
+        return seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+      }
+
+      /**
+       * string that references the parser input, the text is
+       * copied into the payload by the first as<String>() const.
+       * Formatting and comparing read it from the input.
+       */
+      struct BorrowedString
+      {
+        const char * data;
+        ::std::size_t size;
+        mutable ::std::once_flag once;
+        mutable String text;
+
+        BorrowedString(const char * _data, ::std::size_t _size) : data(_data), size(_size)
+        {
+        }
+
+        const String & str() const
+        {
+          ::std::call_once(once, [this](){ text.assign(data, size); });
+          return text;
+        }
+      };
+
+      inline Integer toInteger(const String & text)
+      {
+        long long ilvalue = ::std::stoll(text);
+        if(ilvalue > ::std::numeric_limits<Integer>::min() &&
+           ilvalue <= ::std::numeric_limits<Integer>::max())
+        {
+          return Integer(ilvalue);
+        }
+        throw ::std::out_of_range(::std::string("integer value out of range ") + text);
+      }
+
+      inline Float toFloat(const String & text)
+      {
+        long double dvalue = ::std::stold(text);
+        if(dvalue > ::std::numeric_limits<Float>::lowest() &&
+           dvalue <= ::std::numeric_limits<Float>::max())
+        {
+          return Float(dvalue);
+        }
+        throw ::std::out_of_range(::std::string("floating point value out of range ") + text);
+      }
+
+      struct RawInteger {};
+      struct RawFloat {};
+
+      /**
+       * number as it appeared in the input,
+       * converted on first access through the const interface
+       */
+      struct RawNumber
+      {
+        String text;
+        bool isFloat;
+        // converts the one representation selected by isFloat
+        mutable ::std::once_flag once;
+        mutable bool inRange;
+        mutable Integer integer;
+        mutable Float real;
+
+        RawNumber(const String & _text, bool _isFloat)
+          : text(_text), isFloat(_isFloat), inRange(false), integer(0), real(0)
+        {
+        }
+
+        RawNumber(const RawNumber & rhs)
+          : text(rhs.text), isFloat(rhs.isFloat), inRange(false), integer(0), real(0)
+        {
+        }
+
+        /**
+         * false if the text is out of the range of its representation,
+         * such numbers are compared and hashed by their text
+         */
+        bool convert() const
+        {
+          ::std::call_once(once, [this](){
+            try
+            {
+              if(isFloat)
+              {
+                real = details::toFloat(text);
+              }
+              else
+              {
+                integer = details::toInteger(text);
+              }
+              inRange = true;
+            }
+            catch(const ::std::exception &)
+            {
+              inRange = false;
+            }
+          });
+          return inRange;
+        }
+
+        const Integer & toInteger() const
+        {
+          assert(!isFloat);
+          if(!convert())
+          {
+            // throws the conversion error
+            details::toInteger(text);
+          }
+          return integer;
+        }
+
+        const Float & toFloat() const
+        {
+          assert(isFloat);
+          if(!convert())
+          {
+            details::toFloat(text);
+          }
+          return real;
+        }
+      };
+
+      struct DeferredArray {};
+      struct DeferredObject {};
+
+      /**
+       * array or object kept as source text, parsed on first
+       * access through the const interface
+       */
+      struct Deferred
+      {
+        typedef Node::Value (*ParseFunction)(const String & text, const void * context, Arena * arena);
+
+        String text;
+        bool isObject;
+        ParseFunction parse;
+        // parser configuration passed to parse
+        ::std::shared_ptr<const void> context;
+        // arena of the document the subtree is parsed into,
+        // copies are parsed on the heap
+        Arena * arena;
+        mutable ::std::once_flag once;
+        mutable Node::Value parsed;
+
+        Deferred(String && _text, bool _isObject, ParseFunction _parse,
+                 const ::std::shared_ptr<const void> & _context, Arena * _arena)
+          : text(::std::move(_text)), isObject(_isObject), parse(_parse), context(_context), arena(_arena),
+            parsed(Null())
+        {
+        }
+
+        Deferred(const Deferred & rhs)
+          : text(rhs.text), isObject(rhs.isObject), parse(rhs.parse), context(rhs.context), arena(nullptr),
+            parsed(Null())
+        {
+        }
+
+        const Node::Value & get() const
+        {
+          ::std::call_once(once, [this](){ parsed = parse(text, context.get(), arena); });
+          return parsed;
+        }
+
+        /**
+         * the parsed value, moved out if the caller is the only owner
+         */
+        Node::Value take(bool exclusive)
+        {
+          get();
+          if(exclusive)
+          {
+            return ::std::move(parsed);
+          }
+          return parsed;
+        }
+      };
+
+      /**
+       * maps a type to the placeholder type that isA<T>() also accepts
+       */
+      template<typename T>
+      struct LazyOf
+      {
+        static bool matches(const ::std::type_index & t)
+        {
+          return false;
+        }
+      };
+
+      template<>
+      struct LazyOf<String>
+      {
+        static bool matches(const ::std::type_index & t)
+        {
+          return t == ::std::type_index(typeid(BorrowedString));
+        }
+      };
+
+      template<>
+      struct LazyOf<Array>
+      {
+        static bool matches(const ::std::type_index & t)
+        {
+          return t == ::std::type_index(typeid(DeferredArray));
+        }
+      };
+
+      template<>
+      struct LazyOf<Object>
+      {
+        static bool matches(const ::std::type_index & t)
+        {
+          return t == ::std::type_index(typeid(DeferredObject));
+        }
+      };
+
+      template<>
+      struct LazyOf<Integer>
+      {
+        static bool matches(const ::std::type_index & t)
+        {
+          return t == ::std::type_index(typeid(RawInteger));
+        }
+      };
+
+      template<>
+      struct LazyOf<Float>
+      {
+        static bool matches(const ::std::type_index & t)
+        {
+          return t == ::std::type_index(typeid(RawFloat));
+        }
+      };
+
+      /**
+       * heap storage of String, Array and Object values.
+       * A shared payload is immutable and reference counted,
+       * an unshared payload is owned by exactly one Value.
+       * Payloads created in an arena are destroyed with the arena,
+       * copying them always yields a heap payload.
+       * Within a PayloadPoolScope heap payloads come from the SlabPool.
+       */
+      template<typename T>
+      struct Payload
+      {
+        T value;
+        ::std::atomic<::std::uint32_t> refs;
+        bool shared;
+        bool inArena;
+        bool pooled;
+
+        template<typename... ARGS>
+        explicit Payload(ARGS&&... args)
+          : value(::std::forward<ARGS>(args)...), refs(1), shared(false), inArena(false), pooled(false)
+        {
+        }
+
+        template<typename... ARGS>
+        static Payload * create(ARGS&&... args)
+        {
+          bool pooled = (payloadPoolDepth() != 0);
+          void * mem = (pooled ? SlabPool<Payload>::allocate() : ::operator new(sizeof(Payload)));
+          Payload * ret;
+          try
+          {
+            ret = ::new (mem) Payload(::std::forward<ARGS>(args)...);
+          }
+          catch(...)
+          {
+            free(mem, pooled);
+            throw;
+          }
+          ret->pooled = pooled;
+          return ret;
+        }
+
+        /**
+         * destroy a heap payload, the memory goes back to where it came from
+         */
+        static void destroy(Payload * p)
+        {
+          bool pooled = p->pooled;
+          p->~Payload();
+          free(p, pooled);
+        }
+
+        static void free(void * mem, bool pooled)
+        {
+          if(pooled)
+          {
+            SlabPool<Payload>::deallocate(mem);
+          }
+          else
+          {
+            ::operator delete(mem);
+          }
+        }
+
+        template<typename... ARGS>
+        static Payload * createIn(Arena & arena, ARGS&&... args)
+        {
+          void * mem = arena.allocate(sizeof(Payload), alignof(Payload));
+          Payload * ret = ::new (mem) Payload(::std::forward<ARGS>(args)...);
+          ret->inArena = true;
+          arena.addCleanup(ret);
+          return ret;
+        }
+
+        static Payload * copy(Payload * p)
+        {
+          if(p->shared && !p->inArena)
+          {
+            p->refs.fetch_add(1, ::std::memory_order_relaxed);
+            return p;
+          }
+          else
+          {
+            return create(p->value);
+          }
+        }
+
+        /**
+         * returns a payload that may be modified by the caller
+         */
+        static Payload * unshare(Payload * p)
+        {
+          if(!p->shared)
+          {
+            return p;
+          }
+          else if(p->refs.load(::std::memory_order_acquire) == 1)
+          {
+            p->shared = false;
+            return p;
+          }
+          else
+          {
+            Payload * ret = create(p->value);
+            release(p);
+            return ret;
+          }
+        }
+
+        /**
+         * share a payload between values of the same document,
+         * the reference is taken even for arena payloads
+         */
+        static Payload * ref(Payload * p)
+        {
+          p->refs.fetch_add(1, ::std::memory_order_relaxed);
+          return p;
+        }
+
+        /**
+         * drop a reference, returns true if the caller
+         * held the last one and must delete the payload
+         */
+        static bool drop(Payload * p)
+        {
+          if(p->inArena)
+          {
+            if(p->shared)
+            {
+              p->refs.fetch_sub(1, ::std::memory_order_acq_rel);
+            }
+            return false;
+          }
+          return !p->shared || p->refs.fetch_sub(1, ::std::memory_order_acq_rel) == 1;
+        }
+
+        static void release(Payload * p)
+        {
+          if(drop(p))
+          {
+            destroy(p);
+          }
+        }
+      };
     }
   }
 }
@@ -101,29 +491,62 @@ inline surfsara::ast::Node::Value::Value(const Float & f) : typeIndex(std::type_
 
 inline surfsara::ast::Node::Value::Value(const String & s) : typeIndex(std::type_index(typeid(String)))
 {
-  v.stringValue = new String(s);
+  v.stringValue = details::Payload<String>::create(s);
 }
 
 inline surfsara::ast::Node::Value::Value(const Array & a) : typeIndex(std::type_index(typeid(Array)))
 {
-  v.arrayValue = new Array(a);
+  v.arrayValue = details::Payload<Array>::create(a);
 }
 
 inline surfsara::ast::Node::Value::Value(Array && a) : typeIndex(std::type_index(typeid(Array)))
 {
-  v.arrayValue = new Array();
-  v.arrayValue->swap(a);
+  v.arrayValue = details::Payload<Array>::create();
+  v.arrayValue->value.swap(a);
 }
 
 inline surfsara::ast::Node::Value::Value(const Object & o) : typeIndex(std::type_index(typeid(Object)))
 {
-  v.objectValue = new Object(o);
+  v.objectValue = details::Payload<Object>::create(o);
 }
 
 inline surfsara::ast::Node::Value::Value(Object && o) : typeIndex(std::type_index(typeid(Object)))
 {
-  v.objectValue = new Object();
-  v.objectValue->swap(o);
+  v.objectValue = details::Payload<Object>::create();
+  v.objectValue->value.swap(o);
+}
+
+inline surfsara::ast::Node::Value::Value(details::Payload<String> * s) : typeIndex(std::type_index(typeid(String)))
+{
+  v.stringValue = s;
+}
+
+inline surfsara::ast::Node::Value::Value(details::Payload<Array> * a) : typeIndex(std::type_index(typeid(Array)))
+{
+  v.arrayValue = a;
+}
+
+inline surfsara::ast::Node::Value::Value(details::Payload<Object> * o) : typeIndex(std::type_index(typeid(Object)))
+{
+  v.objectValue = o;
+}
+
+inline surfsara::ast::Node::Value::Value(details::Payload<details::BorrowedString> * s)
+  : typeIndex(std::type_index(typeid(details::BorrowedString)))
+{
+  v.borrowedValue = s;
+}
+
+inline surfsara::ast::Node::Value::Value(details::Payload<details::RawNumber> * n)
+  : typeIndex(n->value.isFloat ? std::type_index(typeid(details::RawFloat)) : std::type_index(typeid(details::RawInteger)))
+{
+  v.rawNumber = n;
+}
+
+inline surfsara::ast::Node::Value::Value(details::Payload<details::Deferred> * d)
+  : typeIndex(d->value.isObject ? std::type_index(typeid(details::DeferredObject)) : std::type_index(typeid(details::DeferredArray)))
+{
+  v.deferredValue = d;
 }
 
 inline surfsara::ast::Node::Value::Value(const Value & rhs) : typeIndex(rhs.typeIndex)
@@ -131,7 +554,7 @@ inline surfsara::ast::Node::Value::Value(const Value & rhs) : typeIndex(rhs.type
   init(rhs);
 }
 
-inline surfsara::ast::Node::Value::Value(Value && rhs) : typeIndex(rhs.typeIndex)
+inline surfsara::ast::Node::Value::Value(Value && rhs) noexcept : typeIndex(rhs.typeIndex)
 {
   v = rhs.v;
   rhs.typeIndex = std::type_index(typeid(Null));
@@ -139,9 +562,29 @@ inline surfsara::ast::Node::Value::Value(Value && rhs) : typeIndex(rhs.typeIndex
 
 inline surfsara::ast::Node::Value & surfsara::ast::Node::Value::operator=(const Value & rhs)
 {
-  cleanup();
-  typeIndex = rhs.typeIndex;
-  init(rhs);
+  if(this != &rhs)
+  {
+    // copy first, rhs may be part of this value
+    Value tmp(rhs);
+    cleanup();
+    typeIndex = tmp.typeIndex;
+    v = tmp.v;
+    tmp.typeIndex = std::type_index(typeid(Null));
+  }
+  return *this;
+}
+
+inline surfsara::ast::Node::Value & surfsara::ast::Node::Value::operator=(Value && rhs) noexcept
+{
+  if(this != &rhs)
+  {
+    // detach first, rhs may be part of this value
+    Value tmp(std::move(rhs));
+    cleanup();
+    typeIndex = tmp.typeIndex;
+    v = tmp.v;
+    tmp.typeIndex = std::type_index(typeid(Null));
+  }
   return *this;
 }
 
@@ -153,7 +596,16 @@ inline surfsara::ast::Node::Value::~Value()
 template<typename T>
 inline bool surfsara::ast::Node::Value::isA() const
 {
-  return typeIndex == std::type_index(typeid(T));
+  return typeIndex == std::type_index(typeid(T)) || details::LazyOf<T>::matches(typeIndex);
+}
+
+inline bool surfsara::ast::Node::Value::isLazy() const
+{
+  return (typeIndex == std::type_index(typeid(details::BorrowedString)) ||
+          typeIndex == std::type_index(typeid(details::RawInteger)) ||
+          typeIndex == std::type_index(typeid(details::RawFloat)) ||
+          typeIndex == std::type_index(typeid(details::DeferredArray)) ||
+          typeIndex == std::type_index(typeid(details::DeferredObject)));
 }
 
 
@@ -164,48 +616,423 @@ const T& surfsara::ast::Node::Value::as() const
   return converter::convert(*this);
 }
 
-template<typename T>
-T& surfsara::ast::Node::Value::as()
+template<typename T>
+T& surfsara::ast::Node::Value::as()
+{
+  typedef details::Converter<T> converter;
+  return converter::convert(*this);
+}
+
+
+
+inline bool surfsara::ast::Node::Value::stringData(const char *& data, std::size_t & size) const
+{
+  if(typeIndex == std::type_index(typeid(details::BorrowedString)))
+  {
+    data = v.borrowedValue->value.data;
+    size = v.borrowedValue->value.size;
+    return true;
+  }
+  else if(typeIndex == std::type_index(typeid(String)))
+  {
+    data = v.stringValue->value.data();
+    size = v.stringValue->value.size();
+    return true;
+  }
+  return false;
+}
+
+inline const surfsara::ast::details::RawNumber * surfsara::ast::Node::Value::rawNumber() const
+{
+  if(typeIndex == std::type_index(typeid(details::RawInteger)) ||
+     typeIndex == std::type_index(typeid(details::RawFloat)))
+  {
+    return &v.rawNumber->value;
+  }
+  return nullptr;
+}
+
+inline void surfsara::ast::Node::Value::dismissCleanup(details::Arena & arena, std::size_t slot) const
+{
+  // capacity of a string that does not allocate
+  static const std::size_t local = String().capacity();
+  // a value the destructor of its container does not have to release
+  auto inArena = [](const Value & v) {
+    if(v.typeIndex == std::type_index(typeid(String))) return v.v.stringValue->inArena;
+    if(v.typeIndex == std::type_index(typeid(Array))) return v.v.arrayValue->inArena;
+    if(v.typeIndex == std::type_index(typeid(Object))) return v.v.objectValue->inArena;
+    if(v.typeIndex == std::type_index(typeid(details::BorrowedString))) return v.v.borrowedValue->inArena;
+    if(v.typeIndex == std::type_index(typeid(details::RawInteger)) ||
+       v.typeIndex == std::type_index(typeid(details::RawFloat))) return v.v.rawNumber->inArena;
+    if(v.typeIndex == std::type_index(typeid(details::DeferredArray)) ||
+       v.typeIndex == std::type_index(typeid(details::DeferredObject))) return v.v.deferredValue->inArena;
+    return true;
+  };
+  if(typeIndex == std::type_index(typeid(String)))
+  {
+    if(v.stringValue->inArena && v.stringValue->value.capacity() <= local)
+    {
+      arena.dismissCleanup(v.stringValue, slot);
+    }
+  }
+  else if(typeIndex == std::type_index(typeid(details::RawInteger)) ||
+          typeIndex == std::type_index(typeid(details::RawFloat)))
+  {
+    if(v.rawNumber->inArena && v.rawNumber->value.text.capacity() <= local)
+    {
+      arena.dismissCleanup(v.rawNumber, slot);
+    }
+  }
+  else if(typeIndex == std::type_index(typeid(Array)))
+  {
+    const Array & arr(v.arrayValue->value);
+    if(v.arrayValue->inArena && std::all_of(arr.begin(), arr.end(), [&inArena](const Node & n) { return inArena(n.value); }))
+    {
+      arena.dismissCleanup(v.arrayValue, slot);
+    }
+  }
+  else if(typeIndex == std::type_index(typeid(Object)))
+  {
+    const Object & obj(v.objectValue->value);
+    if(v.objectValue->inArena &&
+       std::all_of(obj.begin(), obj.end(), [&inArena](const Object::value_type & p) {
+           return p.first.capacity() <= local && inArena(p.second.value);
+         }))
+    {
+      arena.dismissCleanup(v.objectValue, slot);
+    }
+  }
+  // borrowed strings may be copied and deferred subtrees parsed later
+}
+
+inline bool surfsara::ast::Node::Value::isShared() const
+{
+  if(typeIndex == std::type_index(typeid(String)))
+  {
+    return v.stringValue->shared;
+  }
+  else if(typeIndex == std::type_index(typeid(Array)))
+  {
+    return v.arrayValue->shared;
+  }
+  else if(typeIndex == std::type_index(typeid(Object)))
+  {
+    return v.objectValue->shared;
+  }
+  else if(typeIndex == std::type_index(typeid(details::BorrowedString)))
+  {
+    return v.borrowedValue->shared;
+  }
+  else if(typeIndex == std::type_index(typeid(details::RawInteger)) ||
+          typeIndex == std::type_index(typeid(details::RawFloat)))
+  {
+    return v.rawNumber->shared;
+  }
+  else if(typeIndex == std::type_index(typeid(details::DeferredArray)) ||
+          typeIndex == std::type_index(typeid(details::DeferredObject)))
+  {
+    return v.deferredValue->shared;
+  }
+  return false;
+}
+
+inline void surfsara::ast::Node::Value::share()
+{
+  if(typeIndex == std::type_index(typeid(String)))
+  {
+    v.stringValue->shared = true;
+  }
+  else if(typeIndex == std::type_index(typeid(Array)))
+  {
+    v.arrayValue->shared = true;
+  }
+  else if(typeIndex == std::type_index(typeid(Object)))
+  {
+    v.objectValue->shared = true;
+  }
+  else if(typeIndex == std::type_index(typeid(details::BorrowedString)))
+  {
+    v.borrowedValue->shared = true;
+  }
+  else if(typeIndex == std::type_index(typeid(details::RawInteger)) ||
+          typeIndex == std::type_index(typeid(details::RawFloat)))
+  {
+    v.rawNumber->shared = true;
+  }
+  else if(typeIndex == std::type_index(typeid(details::DeferredArray)) ||
+          typeIndex == std::type_index(typeid(details::DeferredObject)))
+  {
+    v.deferredValue->shared = true;
+  }
+}
+
+inline void surfsara::ast::Node::Value::shareFrom(const Value & rhs)
+{
+  Value tmp(Null{});
+  if(rhs.typeIndex == std::type_index(typeid(String)))
+  {
+    tmp = Value(details::Payload<String>::ref(rhs.v.stringValue));
+  }
+  else if(rhs.typeIndex == std::type_index(typeid(Array)))
+  {
+    tmp = Value(details::Payload<Array>::ref(rhs.v.arrayValue));
+  }
+  else if(rhs.typeIndex == std::type_index(typeid(Object)))
+  {
+    tmp = Value(details::Payload<Object>::ref(rhs.v.objectValue));
+  }
+  else if(rhs.typeIndex == std::type_index(typeid(details::BorrowedString)))
+  {
+    tmp = Value(details::Payload<details::BorrowedString>::ref(rhs.v.borrowedValue));
+  }
+  else if(rhs.typeIndex == std::type_index(typeid(details::DeferredArray)) ||
+          rhs.typeIndex == std::type_index(typeid(details::DeferredObject)))
+  {
+    tmp = Value(details::Payload<details::Deferred>::ref(rhs.v.deferredValue));
+  }
+  else if(rhs.isLazy())
+  {
+    tmp = Value(details::Payload<details::RawNumber>::ref(rhs.v.rawNumber));
+  }
+  else
+  {
+    tmp = rhs;
+  }
+  *this = std::move(tmp);
+}
+
+inline void surfsara::ast::Node::Value::init(const Value & rhs)
+{
+  if(rhs.typeIndex == std::type_index(typeid(String)))
+  {
+    v.stringValue = details::Payload<String>::copy(rhs.v.stringValue);
+  }
+  else if(rhs.typeIndex == std::type_index(typeid(Array)))
+  {
+    v.arrayValue = details::Payload<Array>::copy(rhs.v.arrayValue);
+  }
+  else if(rhs.typeIndex == std::type_index(typeid(Object)))
+  {
+    v.objectValue = details::Payload<Object>::copy(rhs.v.objectValue);
+  }
+  else if(rhs.typeIndex == std::type_index(typeid(details::BorrowedString)))
+  {
+    // a copy does not depend on the input buffer
+    typeIndex = std::type_index(typeid(String));
+    v.stringValue = details::Payload<String>::create(rhs.v.borrowedValue->value.data,
+                                                     rhs.v.borrowedValue->value.size);
+  }
+  else if(rhs.typeIndex == std::type_index(typeid(details::DeferredArray)) ||
+          rhs.typeIndex == std::type_index(typeid(details::DeferredObject)))
+  {
+    v.deferredValue = details::Payload<details::Deferred>::copy(rhs.v.deferredValue);
+  }
+  else if(rhs.isLazy())
+  {
+    // keeps the source text
+    v.rawNumber = details::Payload<details::RawNumber>::copy(rhs.v.rawNumber);
+  }
+  else
+  {
+    v = rhs.v;
+  }
+}
+
+inline void surfsara::ast::Node::Value::cleanup()
+{
+  if(typeIndex == std::type_index(typeid(String)))
+  {
+    details::Payload<String>::release(v.stringValue);
+  }
+  else if(typeIndex == std::type_index(typeid(details::BorrowedString)))
+  {
+    details::Payload<details::BorrowedString>::release(v.borrowedValue);
+  }
+  else if(typeIndex == std::type_index(typeid(details::RawInteger)) ||
+          typeIndex == std::type_index(typeid(details::RawFloat)))
+  {
+    details::Payload<details::RawNumber>::release(v.rawNumber);
+  }
+  else if(typeIndex == std::type_index(typeid(details::DeferredArray)) ||
+          typeIndex == std::type_index(typeid(details::DeferredObject)))
+  {
+    details::Payload<details::Deferred>::release(v.deferredValue);
+  }
+  else if(typeIndex == std::type_index(typeid(Array)) ||
+          typeIndex == std::type_index(typeid(Object)))
+  {
+    // nested arrays and objects are destroyed from a worklist,
+    // the depth of the tree does not grow the stack
+    std::vector<Value> work;
+    reclaim(*this, work);
+    while(!work.empty())
+    {
+      Value next(std::move(work.back()));
+      work.pop_back();
+      reclaim(next, work);
+    }
+  }
+}
+
+inline void surfsara::ast::Node::Value::reclaim(Value & value, std::vector<Value> & work)
 {
-  typedef details::Converter<T> converter;
-  return converter::convert(*this);
+  if(value.typeIndex == std::type_index(typeid(Array)))
+  {
+    details::Payload<Array> * p = value.v.arrayValue;
+    value.typeIndex = std::type_index(typeid(Null));
+    if(details::Payload<Array>::drop(p))
+    {
+      Array::Span elements(p->value.span());
+      for(Node & node : elements)
+      {
+        if(node.value.isA<Array>() || node.value.isA<Object>())
+        {
+          work.push_back(std::move(node.value));
+        }
+      }
+      details::Payload<Array>::destroy(p);
+    }
+  }
+  else if(value.typeIndex == std::type_index(typeid(Object)))
+  {
+    details::Payload<Object> * p = value.v.objectValue;
+    value.typeIndex = std::type_index(typeid(Null));
+    if(details::Payload<Object>::drop(p))
+    {
+      for(Object::value_type & pair : p->value)
+      {
+        if(pair.second.value.isA<Array>() || pair.second.value.isA<Object>())
+        {
+          work.push_back(std::move(pair.second.value));
+        }
+      }
+      details::Payload<Object>::destroy(p);
+    }
+  }
 }
 
+inline bool surfsara::ast::Node::Value::operator==(const Value & rhs) const
+{
+  if(isLazy() || rhs.isLazy())
+  {
+    // compare the values the placeholders stand for
+    const char * lhsData;
+    const char * rhsData;
+    std::size_t lhsSize;
+    std::size_t rhsSize;
+    if(stringData(lhsData, lhsSize) && rhs.stringData(rhsData, rhsSize))
+    {
+      // borrowed strings are compared without copying them
+      return lhsSize == rhsSize && std::equal(lhsData, lhsData + lhsSize, rhsData);
+    }
+    const details::RawNumber * lhsNumber = rawNumber();
+    const details::RawNumber * rhsNumber = rhs.rawNumber();
+    if((lhsNumber && !lhsNumber->convert()) || (rhsNumber && !rhsNumber->convert()))
+    {
+      // a number out of range only equals the same literal
+      return (lhsNumber && rhsNumber && lhsNumber->isFloat == rhsNumber->isFloat &&
+              lhsNumber->text == rhsNumber->text);
+    }
+    if(isA<Integer>() && rhs.isA<Integer>())
+    {
+      return as<Integer>() == rhs.as<Integer>();
+    }
+    else if(isA<Float>() && rhs.isA<Float>())
+    {
+      return as<Float>() == rhs.as<Float>();
+    }
+    else if(isA<Array>() && rhs.isA<Array>())
+    {
+      return as<Array>() == rhs.as<Array>();
+    }
+    else if(isA<Object>() && rhs.isA<Object>())
+    {
+      return as<Object>() == rhs.as<Object>();
+    }
+    return false;
+  }
+  if(typeIndex == rhs.typeIndex)
+  {
+    if(typeIndex == std::type_index(typeid(Null)) ||
+       typeIndex == std::type_index(typeid(Undefined)))
+    {
+      return true;
+    }
+    else if(typeIndex == std::type_index(typeid(Boolean)))
+    {
+      return v.booleanValue == rhs.v.booleanValue;
+    }
+    else if(typeIndex == std::type_index(typeid(Integer)))
+    {
+      return v.integerValue == rhs.v.integerValue;
+    }
+    else if(typeIndex == std::type_index(typeid(Float)))
+    {
+      return v.floatValue == rhs.v.floatValue;
+    }
+    else if(typeIndex == std::type_index(typeid(String)))
+    {
+      return v.stringValue == rhs.v.stringValue || v.stringValue->value == rhs.v.stringValue->value;
+    }
+    else if(typeIndex == std::type_index(typeid(Array)))
+    {
+      return v.arrayValue->value == rhs.v.arrayValue->value;
+    }
+    else if(typeIndex == std::type_index(typeid(Object)))
+    {
+      return v.objectValue->value == rhs.v.objectValue->value;
+    }
+  }
+  return false;
+}
 
-
-inline void surfsara::ast::Node::Value::init(const Value & rhs)
+inline std::size_t surfsara::ast::Node::Value::hash() const
 {
-  if(rhs.typeIndex == std::type_index(typeid(String)))
+  std::size_t seed = typeIndex.hash_code();
+  const details::RawNumber * number = rawNumber();
+  if(number && !number->convert())
   {
-    v.stringValue = new String(*rhs.v.stringValue);
+    return details::hashCombine(seed, std::hash<String>()(number->text));
   }
-  else if(rhs.typeIndex == std::type_index(typeid(Array)))
+  if(isA<Boolean>())
   {
-    v.arrayValue = new Array(*rhs.v.arrayValue);
+    return details::hashCombine(seed, std::hash<Boolean>()(v.booleanValue));
   }
-  else if(rhs.typeIndex == std::type_index(typeid(Object)))
+  else if(isA<Integer>())
   {
-    v.objectValue = new Object(*rhs.v.objectValue);
+    seed = std::type_index(typeid(Integer)).hash_code();
+    return details::hashCombine(seed, std::hash<Integer>()(as<Integer>()));
   }
-  else
+  else if(isA<Float>())
   {
-    v = rhs.v;
+    // 0.0 == -0.0
+    seed = std::type_index(typeid(Float)).hash_code();
+    Float f = (as<Float>() == 0.0 ? 0.0 : as<Float>());
+    return details::hashCombine(seed, std::hash<Float>()(f));
   }
-}
-
-inline void surfsara::ast::Node::Value::cleanup()
-{
-  if(typeIndex == std::type_index(typeid(String)))
+  else if(isA<String>())
   {
-    delete v.stringValue;
+    seed = std::type_index(typeid(String)).hash_code();
+    if(typeIndex == std::type_index(typeid(details::BorrowedString)))
+    {
+      // hashed without keeping a copy
+      const details::BorrowedString & s(v.borrowedValue->value);
+      return details::hashCombine(seed, std::hash<String>()(String(s.data, s.size)));
+    }
+    return details::hashCombine(seed, std::hash<String>()(as<String>()));
   }
-  else if(typeIndex == std::type_index(typeid(Array)))
+  else if(isA<Array>())
   {
-    delete v.arrayValue;
+    // shared payloads are copied before they are modified
+    return (isShared() ? as<Array>().cacheHash() : as<Array>().hash());
   }
-  else if(typeIndex == std::type_index(typeid(Object)))
+  else if(isA<Object>())
+  {
+    return (isShared() ? as<Object>().cacheHash() : as<Object>().hash());
+  }
+  else
   {
-    delete v.objectValue;
+    return seed;
   }
 }
 
@@ -227,6 +1054,7 @@ surfsara::ast::Node::Node(T v,
   : value(Integer(v)) {}
 
 inline surfsara::ast::Node::Node(const Value & v) : value(v) {}
+inline surfsara::ast::Node::Node(Value && v) : value(std::move(v)) {}
 inline surfsara::ast::Node::Node(Null a) : value(Null()){}
 inline surfsara::ast::Node::Node(Undefined a) : value(Undefined()){}
 inline surfsara::ast::Node::Node(Boolean a) : value(Boolean(a)){}
@@ -303,11 +1131,19 @@ namespace surfsara
       {
         static const Integer & convert(const Node::Value & v)
         {
+          if(v.typeIndex == std::type_index(typeid(RawInteger)))
+          {
+            return v.v.rawNumber->value.toInteger();
+          }
           return v.v.integerValue;
         }
 
         static Integer & convert(Node::Value & v)
         {
+          if(v.typeIndex == std::type_index(typeid(RawInteger)))
+          {
+            v = Node::Value(v.v.rawNumber->value.toInteger());
+          }
           return v.v.integerValue;
         }
       };
@@ -317,11 +1153,19 @@ namespace surfsara
       {
         static const Float & convert(const Node::Value & v)
         {
+          if(v.typeIndex == std::type_index(typeid(RawFloat)))
+          {
+            return v.v.rawNumber->value.toFloat();
+          }
           return v.v.floatValue;
         }
 
         static Float & convert(Node::Value & v)
         {
+          if(v.typeIndex == std::type_index(typeid(RawFloat)))
+          {
+            v = Node::Value(v.v.rawNumber->value.toFloat());
+          }
           return v.v.floatValue;
         }
       };
@@ -329,30 +1173,55 @@ namespace surfsara
       template<>
       struct Converter<String>
       {
-        static const String  & convert(const Node::Value & v)
+        static const String & convert(const Node::Value & v)
         {
-          return *v.v.stringValue;
+          if(v.typeIndex == std::type_index(typeid(BorrowedString)))
+          {
+            return v.v.borrowedValue->value.str();
+          }
+          return v.v.stringValue->value;
         }
 
         static String & convert(Node::Value & v)
         {
-          return *v.v.stringValue;
+          if(v.typeIndex == std::type_index(typeid(BorrowedString)))
+          {
+            // becomes an ordinary string
+            v = Node::Value(static_cast<const Node::Value &>(v));
+          }
+          v.v.stringValue = details::Payload<String>::unshare(v.v.stringValue);
+          return v.v.stringValue->value;
         }
       };
 
+      inline Node::Value takeDeferred(Node::Value & v)
+      {
+        Payload<Deferred> * p = v.v.deferredValue;
+        return p->value.take(!p->shared || p->refs.load(::std::memory_order_acquire) == 1);
+      }
+
       template<>
       struct Converter<Array>
       {
-        static const Array  & convert(const Node::Value & v)
+        static const Array & convert(const Node::Value & v)
         {
-          return *v.v.arrayValue;
+          if(v.typeIndex == std::type_index(typeid(DeferredArray)))
+          {
+            return v.v.deferredValue->value.get().v.arrayValue->value;
+          }
+          return v.v.arrayValue->value;
         }
 
-        static Array  & convert(Node::Value & v)
+        static Array & convert(Node::Value & v)
         {
-          return *v.v.arrayValue;
+          if(v.typeIndex == std::type_index(typeid(DeferredArray)))
+          {
+            // becomes an ordinary array
+            v = takeDeferred(v);
+          }
+          v.v.arrayValue = details::Payload<Array>::unshare(v.v.arrayValue);
+          return v.v.arrayValue->value;
         }
-
       };
 
       template<>
@@ -360,12 +1229,22 @@ namespace surfsara
       {
         static const Object & convert(const Node::Value & v)
         {
-          return *v.v.objectValue;
+          if(v.typeIndex == std::type_index(typeid(DeferredObject)))
+          {
+            return v.v.deferredValue->value.get().v.objectValue->value;
+          }
+          return v.v.objectValue->value;
         }
 
         static Object & convert(Node::Value & v)
         {
-          return *v.v.objectValue;
+          if(v.typeIndex == std::type_index(typeid(DeferredObject)))
+          {
+            // becomes an ordinary object
+            v = takeDeferred(v);
+          }
+          v.v.objectValue = details::Payload<Object>::unshare(v.v.objectValue);
+          return v.v.objectValue->value;
         }
       };
     }
@@ -400,39 +1279,7 @@ inline std::string surfsara::ast::Node::typeName() const
 
 inline bool surfsara::ast::Node::operator==(const Node & rhs) const
 {
-  if(value.typeIndex == rhs.value.typeIndex)
-  {
-    if(value.typeIndex == std::type_index(typeid(Null)) ||
-       value.typeIndex == std::type_index(typeid(Undefined)))
-    {
-      return true;
-    }
-    else if(value.typeIndex == std::type_index(typeid(Boolean)))
-    {
-      return value.v.booleanValue == rhs.value.v.booleanValue;
-    }
-    else if(value.typeIndex == std::type_index(typeid(Integer)))
-    {
-      return value.v.integerValue == rhs.value.v.integerValue;
-    }
-    else if(value.typeIndex == std::type_index(typeid(Float)))
-    {
-      return value.v.floatValue == rhs.value.v.floatValue;
-    }
-    else if(value.typeIndex == std::type_index(typeid(String)))
-    {
-      return *value.v.stringValue == *rhs.value.v.stringValue;
-    }
-    else if(value.typeIndex == std::type_index(typeid(Array)))
-    {
-      return *value.v.arrayValue == *rhs.value.v.arrayValue;
-    }
-    else if(value.typeIndex == std::type_index(typeid(Object)))
-    {
-      return *value.v.objectValue == *rhs.value.v.objectValue;
-    }
-  }
-  return false;
+  return value == rhs.value;
 }
 
 inline bool surfsara::ast::Node::operator!=(const Node & rhs) const
@@ -441,6 +1288,77 @@ inline bool surfsara::ast::Node::operator!=(const Node & rhs) const
   //return !(value == rhs.value);
 }
 
+inline std::size_t surfsara::ast::Node::hash() const
+{
+  return value.hash();
+}
+
+inline bool surfsara::ast::Node::isShared() const
+{
+  return value.isShared();
+}
+
+inline bool surfsara::ast::Node::isLazy() const
+{
+  return value.isLazy();
+}
+
+inline surfsara::ast::Node::Value surfsara::ast::Node::release()
+{
+  return std::move(value);
+}
+
+inline const surfsara::ast::String * surfsara::ast::Node::deferredText() const
+{
+  if(value.typeIndex == std::type_index(typeid(details::DeferredArray)) ||
+     value.typeIndex == std::type_index(typeid(details::DeferredObject)))
+  {
+    return &value.v.deferredValue->value.text;
+  }
+  return nullptr;
+}
+
+inline bool surfsara::ast::Node::stringData(const char *& data, std::size_t & size) const
+{
+  return value.stringData(data, size);
+}
+
+inline const surfsara::ast::String * surfsara::ast::Node::numberText() const
+{
+  if(value.typeIndex == std::type_index(typeid(details::RawInteger)) ||
+     value.typeIndex == std::type_index(typeid(details::RawFloat)))
+  {
+    return &value.v.rawNumber->value.text;
+  }
+  return nullptr;
+}
+
+inline surfsara::ast::PayloadPoolScope::PayloadPoolScope(bool enable) : enabled(enable)
+{
+  if(enabled)
+  {
+    details::payloadPoolDepth()++;
+  }
+}
+
+inline surfsara::ast::PayloadPoolScope::~PayloadPoolScope()
+{
+  if(enabled)
+  {
+    details::payloadPoolDepth()--;
+  }
+}
+
+template<typename T>
+inline surfsara::ast::PoolStatistics surfsara::ast::poolStatistics()
+{
+  static_assert(std::is_same<T, String>::value ||
+                std::is_same<T, Array>::value ||
+                std::is_same<T, Object>::value,
+                "payload pools exist for String, Array and Object");
+  return details::SlabPool<details::Payload<T>>::statistics();
+}
+
 template<typename Visitor>
 void surfsara::ast::Node::applyVisitor(Visitor & visitor) const
 {
@@ -478,6 +1396,148 @@ void surfsara::ast::Node::applyVisitor(Visitor & visitor) const
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// dedupe
+//
+////////////////////////////////////////////////////////////////////////////////
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace details
+    {
+      /**
+       * table of shared payloads indexed by their structural hash
+       */
+      class Deduplicator
+      {
+      public:
+        /**
+         * Replaces the payload of value by an equal shared payload seen before,
+         * otherwise the payload is shared and registered.
+         * Returns true if the payload was replaced.
+         */
+        bool intern(Node::Value & value)
+        {
+          if(!value.isA<String>() && !value.isA<Array>() && !value.isA<Object>())
+          {
+            return false;
+          }
+          if(value.typeIndex == std::type_index(typeid(DeferredArray)) ||
+             value.typeIndex == std::type_index(typeid(DeferredObject)))
+          {
+            // would have to be parsed
+            return false;
+          }
+          std::size_t h = value.hash();
+          auto range = table.equal_range(h);
+          for(auto itr = range.first; itr != range.second; ++itr)
+          {
+            if(itr->second == value)
+            {
+              value.shareFrom(itr->second);
+              return true;
+            }
+          }
+          value.share();
+          table.emplace(h, Node::Value(Null()))->second.shareFrom(value);
+          return false;
+        }
+
+        /**
+         * the buckets of a large table are released as well
+         */
+        void clear()
+        {
+          if(table.bucket_count() > 4096)
+          {
+            std::unordered_multimap<std::size_t, Node::Value>().swap(table);
+          }
+          else
+          {
+            table.clear();
+          }
+        }
+
+      private:
+        std::unordered_multimap<std::size_t, Node::Value> table;
+      };
+    }
+  }
+}
+
+inline void surfsara::ast::Node::dedupe()
+{
+  details::Deduplicator deduplicator;
+  dedupeImpl(deduplicator);
+}
+
+inline void surfsara::ast::Node::dedupeImpl(details::Deduplicator & deduplicator)
+{
+  // the children of shared payloads have been deduplicated before
+  if(!value.isShared())
+  {
+    if(isA<Array>())
+    {
+      for(Node & node : as<Array>())
+      {
+        node.dedupeImpl(deduplicator);
+      }
+    }
+    else if(isA<Object>())
+    {
+      for(Object::value_type & p : as<Object>())
+      {
+        p.second.dedupeImpl(deduplicator);
+      }
+    }
+  }
+  deduplicator.intern(value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// compact
+//
+////////////////////////////////////////////////////////////////////////////////
+inline void surfsara::ast::Node::compact()
+{
+  std::vector<Node*> work({this});
+  while(!work.empty())
+  {
+    Node * node = work.back();
+    work.pop_back();
+    if(node->value.isShared() || node->value.isLazy())
+    {
+      continue;
+    }
+    if(node->isA<String>())
+    {
+      node->as<String>().shrink_to_fit();
+    }
+    else if(node->isA<Array>())
+    {
+      Array & arr(node->as<Array>());
+      arr.shrinkToFit();
+      for(Node & child : arr)
+      {
+        work.push_back(&child);
+      }
+    }
+    else if(node->isA<Object>())
+    {
+      Object & obj(node->as<Object>());
+      obj.shrinkToFit();
+      // keys are copied into the object without spare capacity
+      for(Object::value_type & p : obj)
+      {
+        work.push_back(&p.second);
+      }
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // foreach
@@ -512,20 +1572,21 @@ inline void surfsara::ast::Node::forEachImpl(const Node & root,
       std::string key = path[pos];
       if(key == "*")
       {
-        for(std::size_t index = 0; index < as<Array>().size(); index++)
+        const Array & arr(as<Array>());
+        for(std::size_t index = 0; index < arr.size(); index++)
         {
           realPath.push_back(std::to_string(index));
-          as<Array>()[index].forEachImpl(root, realPath, path, func, pos + 1);
+          arr.unsafeAt(index).forEachImpl(root, realPath, path, func, pos + 1);
           realPath.pop_back();
         }
       }
       else
       {
         std::size_t index = getIndexFromString(key, path);
-        if(as<Array>().size())
+        if(index < as<Array>().size())
         {
           realPath.push_back(key);
-          as<Array>()[index].forEachImpl(root, realPath, path, func, pos + 1);
+          as<Array>().unsafeAt(index).forEachImpl(root, realPath, path, func, pos + 1);
           realPath.pop_back();
         }
       }
@@ -535,13 +1596,12 @@ inline void surfsara::ast::Node::forEachImpl(const Node & root,
       std::string key = path[pos];
       if(key == "*")
       {
-        as<Object>().forEach([&root, &realPath, &func, &path, pos](const std::string & key,
-                                                                   const Node & n) 
-                    {
-                      realPath.push_back(key);
-                      n.forEachImpl(root, realPath, path, func, pos + 1);
-                      realPath.pop_back();
-                    });
+        for(const Object::value_type & p : as<Object>())
+        {
+          realPath.push_back(p.first);
+          p.second.forEachImpl(root, realPath, path, func, pos + 1);
+          realPath.pop_back();
+        }
       }
       else if(as<Object>().has(key))
       {
@@ -622,10 +1682,11 @@ inline surfsara::ast::Node surfsara::ast::Node::findImpl(const Node & root,
       }
       else if(key == "*")
       {
-        for(std::size_t index = 0; index < as<Array>().size(); index++)
+        const Array & arr(as<Array>());
+        for(std::size_t index = 0; index < arr.size(); index++)
         {
           realPath.push_back(std::to_string(index));
-          auto tmp = as<Array>()[index].findImpl(root, realPath, path, pred, pos + 1);
+          auto tmp = arr.unsafeAt(index).findImpl(root, realPath, path, pred, pos + 1);
           realPath.pop_back();
           if(tmp != Undefined())
           {
@@ -640,7 +1701,7 @@ inline surfsara::ast::Node surfsara::ast::Node::findImpl(const Node & root,
         if(index < as<Array>().size())
         {
           realPath.push_back(std::to_string(index));
-          auto ret = as<Array>()[index].findImpl(root, realPath, path, pred, pos + 1);
+          auto ret = as<Array>().unsafeAt(index).findImpl(root, realPath, path, pred, pos + 1);
           realPath.pop_back();
           return ret;
         }
@@ -654,18 +1715,17 @@ inline surfsara::ast::Node surfsara::ast::Node::findImpl(const Node & root,
     {
       if(key == "*")
       {
-        Node ret = Undefined();
-        as<Object>().forEach([&root, &ret, &pred, &realPath, &path, pos](const std::string & key,
-                                                                         const Node & node) 
-                             {
-                               if(ret == Undefined())
-                               {
-                                 realPath.push_back(key);
-                                 ret = node.findImpl(node, realPath, path, pred, pos + 1);
-                                 realPath.pop_back();
-                               }
-                             });
-        return ret;
+        for(const Object::value_type & p : as<Object>())
+        {
+          realPath.push_back(p.first);
+          Node ret = p.second.findImpl(p.second, realPath, path, pred, pos + 1);
+          realPath.pop_back();
+          if(ret != Undefined())
+          {
+            return ret;
+          }
+        }
+        return Undefined();
       }
       else if(as<Object>().has(key))
       {
@@ -806,7 +1866,7 @@ inline bool surfsara::ast::Node::updateArrayImpl(Array & arr,
     for(std::size_t index = 0; index < arr.size(); index++)
     {
       ws.realPath.push_back(std::to_string(index));
-      ret |= arr[index].updateImpl(ws, pos + 1, true);
+      ret |= arr.unsafeAt(index).updateImpl(ws, pos + 1, true);
       ws.realPath.pop_back();
     }
     return ret;
@@ -814,10 +1874,10 @@ inline bool surfsara::ast::Node::updateArrayImpl(Array & arr,
   else
   {
     std::size_t index = getIndexFromString(key, ws.path);
-    if(arr.size())
+    if(index < arr.size())
     {
       ws.realPath.push_back(key);
-      arr[index].updateImpl(ws, pos + 1, ignoreUndef);
+      arr.unsafeAt(index).updateImpl(ws, pos + 1, ignoreUndef);
       ws.realPath.pop_back();
       return true;
     }
@@ -837,13 +1897,12 @@ inline bool surfsara::ast::Node::updateObjectImpl(Object & obj,
   if(key == "*")
   {
     bool ret = false;
-    obj.forEach([&ws, &ret, pos](const std::string & key,
-                                 Node & n) 
-                {
-                  ws.realPath.push_back(key);
-                  ret |= n.updateImpl(ws, pos + 1, true);
-                  ws.realPath.pop_back();
-                });
+    for(Object::value_type & p : obj)
+    {
+      ws.realPath.push_back(p.first);
+      ret |= p.second.updateImpl(ws, pos + 1, true);
+      ws.realPath.pop_back();
+    }
     return ret;
   }
   else if(ws.insert && !obj.has(key) && !ignoreUndef)
@@ -973,7 +2032,7 @@ inline bool surfsara::ast::Node::removeArrayImpl(Array & arr,
       for(std::size_t index = 0; index < arr.size(); index++)
       {
         realPath.push_back(std::to_string(index));
-        ret |= arr[index].removeImpl(root, realPath, path, predicate, pos + 1, true);
+        ret |= arr.unsafeAt(index).removeImpl(root, realPath, path, predicate, pos + 1, true);
         realPath.pop_back();
       }
     }
@@ -997,7 +2056,7 @@ inline bool surfsara::ast::Node::removeArrayImpl(Array & arr,
       }
       else
       {
-        return arr[index].removeImpl(root, realPath, path, predicate, pos + 1, ignoreUndef);
+        return arr.unsafeAt(index).removeImpl(root, realPath, path, predicate, pos + 1, ignoreUndef);
       }
     }
     return false;
@@ -1016,13 +2075,12 @@ inline bool surfsara::ast::Node::removeObjectImpl(Object & obj,
   if(key == "*")
   {
     bool ret = false;
-    obj.forEach([&root, &realPath, &path, &predicate, &ret, pos](const std::string & key,
-                                                                 Node & n) 
-                {
-                  realPath.push_back(key);
-                  ret |= n.removeImpl(root, realPath, path, predicate, pos + 1, true);
-                  realPath.pop_back();
-                });
+    for(Object::value_type & p : obj)
+    {
+      realPath.push_back(p.first);
+      ret |= p.second.removeImpl(root, realPath, path, predicate, pos + 1, true);
+      realPath.pop_back();
+    }
     return ret;
   }
   else
@@ -1092,3 +2150,15 @@ inline std::size_t surfsara::ast::Node::getIndexFromString(const std::string & s
   }
   return index;
 }
+
+namespace std
+{
+  template<>
+  struct hash<surfsara::ast::Node>
+  {
+    std::size_t operator()(const surfsara::ast::Node & node) const
+    {
+      return node.hash();
+    }
+  };
+}
@@ -28,19 +28,263 @@ SOFTWARE.
 // implementation details don't include directly.
 //
 /////////////////////////////////////////////////////
-inline surfsara::ast::Object::Object()
+namespace surfsara
 {
+  namespace ast
+  {
+    namespace details
+    {
+      struct KeyPayload
+      {
+        KeyPayload(const String & _text) : text(_text), hash(Object::hashKey(_text)) {}
+        KeyPayload(const String & _text, std::size_t _hash) : text(_text), hash(_hash) {}
+        const String text;
+        const std::size_t hash;
+      };
+
+      template<typename ENTRY>
+      struct PairProjection
+      {
+        typedef typename std::remove_const<ENTRY>::type::second_type value_type;
+        typedef typename std::conditional<std::is_const<ENTRY>::value,
+                                          const value_type,
+                                          value_type>::type & reference;
+        static reference get(ENTRY & entry)
+        {
+          return entry.second;
+        }
+      };
+
+      template<typename ENTRY>
+      struct KeyProjection
+      {
+        typedef String value_type;
+        typedef const String & reference;
+        static reference get(ENTRY & entry)
+        {
+          return entry.second.first;
+        }
+      };
+
+      template<typename ENTRY>
+      struct ValueProjection
+      {
+        typedef Node value_type;
+        typedef typename std::conditional<std::is_const<ENTRY>::value,
+                                          const Node,
+                                          Node>::type & reference;
+        static reference get(ENTRY & entry)
+        {
+          return entry.second.second;
+        }
+      };
+
+      /**
+       * adapts an iterator of the index ordered storage of an Object,
+       * PROJECTION selects the part of the entry that is exposed
+       */
+      template<typename BASE, typename PROJECTION>
+      class ObjectIterator
+      {
+      public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef typename PROJECTION::value_type value_type;
+        typedef typename PROJECTION::reference reference;
+        typedef typename std::remove_reference<reference>::type * pointer;
+        typedef std::ptrdiff_t difference_type;
+
+        ObjectIterator() {}
+        explicit ObjectIterator(BASE _itr) : itr(_itr) {}
+
+        template<typename B, typename P>
+        ObjectIterator(const ObjectIterator<B, P> & rhs,
+                       typename std::enable_if<std::is_convertible<B, BASE>::value>::type* = nullptr)
+          : itr(rhs.base()) {}
+
+        reference operator*() const
+        {
+          return PROJECTION::get(*itr);
+        }
+
+        pointer operator->() const
+        {
+          return &PROJECTION::get(*itr);
+        }
+
+        ObjectIterator & operator++()
+        {
+          ++itr;
+          return *this;
+        }
+
+        ObjectIterator operator++(int)
+        {
+          ObjectIterator tmp(*this);
+          ++itr;
+          return tmp;
+        }
+
+        ObjectIterator & operator--()
+        {
+          --itr;
+          return *this;
+        }
+
+        ObjectIterator operator--(int)
+        {
+          ObjectIterator tmp(*this);
+          --itr;
+          return tmp;
+        }
+
+        template<typename B, typename P>
+        bool operator==(const ObjectIterator<B, P> & rhs) const
+        {
+          return itr == rhs.base();
+        }
+
+        template<typename B, typename P>
+        bool operator!=(const ObjectIterator<B, P> & rhs) const
+        {
+          return itr != rhs.base();
+        }
+
+        const BASE & base() const
+        {
+          return itr;
+        }
+
+      private:
+        BASE itr;
+      };
+
+      template<typename ITERATOR>
+      class Range
+      {
+      public:
+        typedef ITERATOR iterator;
+        typedef ITERATOR const_iterator;
+        typedef typename ITERATOR::value_type value_type;
+
+        Range(ITERATOR _first, ITERATOR _last) : first(_first), last(_last) {}
+
+        ITERATOR begin() const
+        {
+          return first;
+        }
+
+        ITERATOR end() const
+        {
+          return last;
+        }
+
+        bool empty() const
+        {
+          return first == last;
+        }
+
+        std::size_t size() const
+        {
+          return std::distance(first, last);
+        }
+
+      private:
+        ITERATOR first;
+        ITERATOR last;
+      };
+    }
+  }
+}
+
+inline surfsara::ast::Key::Key(const String & text)
+  : payload(std::make_shared<const details::KeyPayload>(text))
+{
+}
+
+inline surfsara::ast::Key::Key(std::shared_ptr<const details::KeyPayload> _payload)
+  : payload(std::move(_payload))
+{
+}
+
+inline const surfsara::ast::String & surfsara::ast::Key::str() const
+{
+  return payload->text;
+}
+
+inline std::size_t surfsara::ast::Key::hash() const
+{
+  return payload->hash;
+}
+
+inline bool surfsara::ast::Key::operator==(const Key & rhs) const
+{
+  return (payload == rhs.payload ||
+          (payload->hash == rhs.payload->hash && payload->text == rhs.payload->text));
+}
+
+inline surfsara::ast::Object::Object() : hashValue(0)
+{
+}
+
+inline surfsara::ast::Object::Object(details::Arena & arena)
+  : data(details::Allocator<storage_type::value_type>(&arena)),
+    lookup(details::Allocator<lookup_type::value_type>(&arena)),
+    hashValue(0)
+{
+}
+
+inline surfsara::ast::Object::Object(const std::initializer_list<std::pair<String, Node>> & l) : hashValue(0)
+{
+  for(auto & p : l)
+  {
+    setInternal(p.first, hashKey(p.first), p.second);
+  }
+}
+
+inline bool surfsara::ast::Object::operator==(const Object & rhs) const
+{
+  if(this == &rhs)
+  {
+    return true;
+  }
+  if(data.size() != rhs.data.size())
+  {
+    return false;
+  }
+  if(hashValue != 0 && rhs.hashValue != 0 && hashValue != rhs.hashValue)
+  {
+    return false;
+  }
+  for(auto itr = data.begin(), itr2 = rhs.data.begin(); itr != data.end(); ++itr, ++itr2)
+  {
+    if(itr->second.first != itr2->second.first ||
+       itr->second.second != itr2->second.second)
+    {
+      return false;
+    }
+  }
+  return true;
 }
 
-inline surfsara::ast::Object::Object(const std::initializer_list<std::pair<String, Node>> & l)
+inline std::size_t surfsara::ast::Object::hash() const
 {
-  std::size_t index = 0;
-  for(auto p : l)
+  if(hashValue != 0)
+  {
+    return hashValue;
+  }
+  std::size_t h = details::hashCombine(data.size(), std::type_index(typeid(Object)).hash_code());
+  for(auto & p : data)
   {
-    data[index] = p;
-    lookup[p.first] = index;
-    index++;
+    h = details::hashCombine(h, p.first.keyHash);
+    h = details::hashCombine(h, p.second.second.hash());
   }
+  return (h == 0 ? 1 : h);
+}
+
+inline std::size_t surfsara::ast::Object::cacheHash() const
+{
+  hashValue = hash();
+  return hashValue;
 }
 
 inline bool surfsara::ast::Object::empty() const
@@ -50,94 +294,122 @@ inline bool surfsara::ast::Object::empty() const
 
 inline bool surfsara::ast::Object::set(const String & k, const Node & node)
 {
-  return setInternal(k, node);
+  return setInternal(k, hashKey(k), node);
 }
 
 inline bool surfsara::ast::Object::set(const String & k, Node && node)
 {
-  return setInternal(k, node);
+  return setInternal(k, hashKey(k), std::move(node));
 }
 
 inline bool surfsara::ast::Object::has(const String & v) const
 {
-  return lookup.find(v) != lookup.end();
+  return has(v, hashKey(v));
 }
 
 inline surfsara::ast::Node surfsara::ast::Object::get(const String & k) const
 {
-  auto itr = lookup.find(k);
-  if(itr == lookup.end())
-  {
-    return Undefined();
-  }
-  auto itr2 = data.find(itr->second);
-  if(itr2 != data.end())
-  {
-    return itr2->second.second;
-  }
-  else
+  return get(k, hashKey(k));
+}
+
+inline std::size_t surfsara::ast::Object::hashKey(const String & k)
+{
+  return std::hash<String>()(k);
+}
+
+inline bool surfsara::ast::Object::set(const String & k, std::size_t keyHash, const Node & node)
+{
+  return setInternal(k, keyHash, node);
+}
+
+inline bool surfsara::ast::Object::set(const String & k, std::size_t keyHash, Node && node)
+{
+  return setInternal(k, keyHash, std::move(node));
+}
+
+inline bool surfsara::ast::Object::has(const String & k, std::size_t keyHash) const
+{
+  return locate(k, keyHash) != data.end();
+}
+
+inline bool surfsara::ast::Object::set(const Key & k, const Node & node)
+{
+  return setInternal(k.str(), k.hash(), node);
+}
+
+inline bool surfsara::ast::Object::set(const Key & k, Node && node)
+{
+  return setInternal(k.str(), k.hash(), std::move(node));
+}
+
+inline bool surfsara::ast::Object::has(const Key & k) const
+{
+  return has(k.str(), k.hash());
+}
+
+inline surfsara::ast::Node surfsara::ast::Object::get(const Key & k) const
+{
+  return get(k.str(), k.hash());
+}
+
+inline surfsara::ast::Node surfsara::ast::Object::get(const String & k, std::size_t keyHash) const
+{
+  auto itr = locate(k, keyHash);
+  if(itr == data.end())
   {
     return Undefined();
   }
+  return itr->second.second;
 }
 
 inline surfsara::ast::Node& surfsara::ast::Object::operator[](const String & key)
 {
-  auto itr = lookup.find(key);
-  if(itr == lookup.end())
+  hashValue = 0;
+  std::size_t h = hashKey(key);
+  auto itr = locate(key, h);
+  if(itr == data.end())
   {
     auto index = 0u;
     if(!data.empty())
     {
-      index = data.rbegin()->first + 1;
+      index = data.rbegin()->first.index + 1;
     }
-    Node undef = Undefined();
-    auto itr2 = data.insert(std::make_pair(index, std::make_pair(key, undef)));
-    lookup[key] = index;
-    return itr2.first->second.second;
+    itr = data.emplace_hint(data.end(), details::MemberPosition(index, h), value_type(key, Node(Undefined())));
+    lookup.emplace(h, index);
   }
-  auto itr2 = data.find(itr->second);
-  if(itr2 != data.end())
-  {
-    return itr2->second.second;
-  }
-  throw std::runtime_error("internal error: Object inconsistent");
+  return itr->second.second;
 }
 
 inline const surfsara::ast::Node& surfsara::ast::Object::operator[](const String & k) const
 {
   static Node undef = Undefined();
-  auto itr = lookup.find(k);
-  if(itr == lookup.end())
+  auto itr = locate(k, hashKey(k));
+  if(itr == data.end())
   {
     return undef;
   }
-  auto itr2 = data.find(itr->second);
-  if(itr2 != data.end())
-  {
-    return itr2->second.second;
-  }
-  throw std::runtime_error("internal error: Object inconsistent");
+  return itr->second.second;
 }
 
 
 inline bool surfsara::ast::Object::modify(const String & key, std::function<void(Node & node)> lambda)
 {
-  auto itr = lookup.find(key);
-  if(itr == lookup.end())
+  hashValue = 0;
+  auto itr = locate(key, hashKey(key));
+  if(itr == data.end())
   {
     return false;
   }
   else
   {
-    auto itr2 = data.find(itr->second);
-    lambda(itr2->second.second);
+    lambda(itr->second.second);
     return true;
   }
 }
 
 inline void surfsara::ast::Object::forEach(std::function<void(const String & key, Node & node)> lambda)
 {
+  hashValue = 0;
   for(auto & p : data)
   {
     lambda(p.second.first, p.second.second);
@@ -180,26 +452,29 @@ inline std::size_t surfsara::ast::Object::size() const
 
 inline bool surfsara::ast::Object::remove(const String & key)
 {
-  auto itr = lookup.find(key);
+  hashValue = 0;
+  auto itr = findEntry(key, hashKey(key));
   if(itr == lookup.end())
   {
     return false;
   }
   else
   {
-    data.erase(itr->second);
-    lookup.erase(key);
+    data.erase(details::MemberPosition(itr->second));
+    lookup.erase(itr);
     return true;
   }
 }
 
 inline std::size_t surfsara::ast::Object::remove(std::function<bool(const String &, const Node & n)> predicate)
 {
+  hashValue = 0;
   std::size_t n = 0;
   for(auto itr = data.begin(); itr != data.end();)
   {
     if(predicate(itr->second.first, itr->second.second))
     {
+      eraseEntry(itr);
       itr = data.erase(itr);
       n++;
     }
@@ -212,40 +487,147 @@ inline std::size_t surfsara::ast::Object::remove(std::function<bool(const String
 }
 
 template<typename T>
-bool surfsara::ast::Object::setInternal(const String & key, T node)
+bool surfsara::ast::Object::setInternal(const String & key, std::size_t h, T node)
 {
-  auto itr = lookup.find(key);
-  if(itr == lookup.end())
+  hashValue = 0;
+  auto itr = locate(key, h);
+  if(itr == data.end())
   {
     auto index = 0u;
     if(!data.empty())
     {
-      index = data.rbegin()->first + 1;
+      index = data.rbegin()->first.index + 1;
     }
-    data[index] = std::make_pair(key, node);
-    lookup[key] = index;
+    data.emplace_hint(data.end(), details::MemberPosition(index, h), value_type(key, std::move(node)));
+    lookup.emplace(h, index);
     return true;
   }
   else
   {
-    data[itr->second] = std::make_pair(key, node);
+    itr->second.second = std::move(node);
     return false;
   }
 }
 
-inline surfsara::ast::Object::iterator surfsara::ast::Object::end()
+inline surfsara::ast::Object::lookup_type::iterator surfsara::ast::Object::findEntry(const String & k, std::size_t h)
+{
+  auto range = lookup.equal_range(h);
+  for(auto itr = range.first; itr != range.second; ++itr)
+  {
+    if(data.find(details::MemberPosition(itr->second))->second.first == k)
+    {
+      return itr;
+    }
+  }
+  return lookup.end();
+}
+
+inline surfsara::ast::Object::storage_type::iterator surfsara::ast::Object::locate(const String & k, std::size_t h)
 {
+  auto range = lookup.equal_range(h);
+  for(auto itr = range.first; itr != range.second; ++itr)
+  {
+    auto itr2 = data.find(details::MemberPosition(itr->second));
+    if(itr2->second.first == k)
+    {
+      return itr2;
+    }
+  }
   return data.end();
 }
 
+inline surfsara::ast::Object::storage_type::const_iterator surfsara::ast::Object::locate(const String & k, std::size_t h) const
+{
+  auto range = lookup.equal_range(h);
+  for(auto itr = range.first; itr != range.second; ++itr)
+  {
+    auto itr2 = data.find(details::MemberPosition(itr->second));
+    if(itr2->second.first == k)
+    {
+      return itr2;
+    }
+  }
+  return data.end();
+}
+
+inline void surfsara::ast::Object::eraseEntry(storage_type::const_iterator itr)
+{
+  auto range = lookup.equal_range(itr->first.keyHash);
+  for(auto itr2 = range.first; itr2 != range.second; ++itr2)
+  {
+    if(itr2->second == itr->first.index)
+    {
+      lookup.erase(itr2);
+      return;
+    }
+  }
+}
+
+inline surfsara::ast::Object::KeyView surfsara::ast::Object::keyView() const
+{
+  typedef KeyView::iterator iter_t;
+  return KeyView(iter_t(data.begin()), iter_t(data.end()));
+}
+
+inline surfsara::ast::Object::ValueView surfsara::ast::Object::valueView()
+{
+  hashValue = 0;
+  typedef ValueView::iterator iter_t;
+  return ValueView(iter_t(data.begin()), iter_t(data.end()));
+}
+
+inline surfsara::ast::Object::ConstValueView surfsara::ast::Object::valueView() const
+{
+  typedef ConstValueView::iterator iter_t;
+  return ConstValueView(iter_t(data.begin()), iter_t(data.end()));
+}
+
+inline surfsara::ast::Object::iterator surfsara::ast::Object::begin()
+{
+  hashValue = 0;
+  return iterator(data.begin());
+}
+
+inline surfsara::ast::Object::iterator surfsara::ast::Object::end()
+{
+  hashValue = 0;
+  return iterator(data.end());
+}
+
+inline surfsara::ast::Object::const_iterator surfsara::ast::Object::begin() const
+{
+  return const_iterator(data.begin());
+}
+
+inline surfsara::ast::Object::const_iterator surfsara::ast::Object::end() const
+{
+  return const_iterator(data.end());
+}
+
+inline surfsara::ast::Object::const_iterator surfsara::ast::Object::cbegin() const
+{
+  return const_iterator(data.begin());
+}
+
+inline surfsara::ast::Object::const_iterator surfsara::ast::Object::cend() const
+{
+  return const_iterator(data.end());
+}
+
 inline void surfsara::ast::Object::insert(iterator itr, const Pair & value)
 {
-  setInternal(value.first, value.second);
+  setInternal(value.first, hashKey(value.first), value.second);
+}
+
+inline void surfsara::ast::Object::shrinkToFit()
+{
+  lookup.rehash(0);
 }
 
 inline void surfsara::ast::Object::swap(Object & rhs)
 {
   data.swap(rhs.data);
   lookup.swap(rhs.lookup);
+  std::swap(hashValue, rhs.hashValue);
 }
 
@@ -0,0 +1,318 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+#include <surfsara/ast.h>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace detail
+    {
+      /**
+       * paths of parseJson(str, paths) split into segments
+       */
+      class PathFilter
+      {
+      public:
+        enum Match
+        {
+          NONE,
+          PARTIAL,
+          FULL
+        };
+
+        // index of the path and of its next segment
+        typedef std::pair<std::size_t, std::size_t> Candidate;
+
+        explicit PathFilter(const std::vector<std::string> & paths)
+        {
+          for(const std::string & path : paths)
+          {
+            segments.push_back(std::vector<Segment>());
+            for(const std::string & name : details::split(path, "/"))
+            {
+              segments.back().push_back(Segment(name));
+            }
+          }
+        }
+
+        /**
+         * candidates of the root
+         */
+        void initial(std::vector<Candidate> & child) const
+        {
+          child.clear();
+          for(std::size_t i = 0; i < segments.size(); i++)
+          {
+            child.push_back(Candidate(i, 0));
+          }
+        }
+
+        /**
+         * match an object member (key != nullptr) or array element
+         * against the candidates of its parent
+         */
+        Match match(const std::vector<Candidate> & parent,
+                    const String * key,
+                    std::size_t index,
+                    std::vector<Candidate> & child) const
+        {
+          Match ret = NONE;
+          child.clear();
+          for(const Candidate & c : parent)
+          {
+            const Segment & s(segments[c.first][c.second]);
+            if(s.any || (key ? s.name == *key : (s.index == index || s.name == "#")))
+            {
+              if(c.second + 1 == segments[c.first].size())
+              {
+                return FULL;
+              }
+              child.push_back(Candidate(c.first, c.second + 1));
+              ret = PARTIAL;
+            }
+          }
+          return ret;
+        }
+
+      private:
+        struct Segment
+        {
+          String name;
+          std::size_t index;
+          bool any;
+
+          explicit Segment(const String & _name)
+            : name(_name), index(std::numeric_limits<std::size_t>::max()), any(_name == "*")
+          {
+            if(!name.empty() && name.find_first_not_of("0123456789") == String::npos)
+            {
+              index = std::stoull(name);
+            }
+          }
+        };
+
+        std::vector<std::vector<Segment>> segments;
+      };
+
+      /**
+       * position of the parser within the paths of a PathFilter,
+       * for each open container on the paths its candidates, the
+       * index of its next element and the action for the current child
+       */
+      class PathMatcher
+      {
+      public:
+        // what happens to a complete child of a filtered container
+        enum Action : char
+        {
+          KEEP,
+          DROP,
+          EMIT
+        };
+
+        PathMatcher()
+          : filter(nullptr), events(false), fullDepth(std::numeric_limits<std::size_t>::max())
+        {
+        }
+
+        /**
+         * with events matching values are emitted instead of kept,
+         * the filter must outlive the matcher
+         */
+        void attach(const PathFilter & _filter, bool _events)
+        {
+          filter = &_filter;
+          events = _events;
+        }
+
+        bool enabled() const
+        {
+          return filter != nullptr;
+        }
+
+        void reset()
+        {
+          next.clear();
+          fullDepth = std::numeric_limits<std::size_t>::max();
+        }
+
+        /**
+         * true if the children of the container at depth are filtered
+         */
+        bool filtering(std::size_t depth) const
+        {
+          return filter && depth > 0 && depth < fullDepth;
+        }
+
+        /**
+         * match the value that begins in the container at depth, key is
+         * nullptr for array elements. NONE means that the value is neither
+         * selected nor on the way to a selected value and can be skipped.
+         */
+        PathFilter::Match begin(std::size_t depth, const String * key, bool isContainer)
+        {
+          if(!filtering(depth))
+          {
+            if(filter && depth == 0)
+            {
+              filter->initial(next);
+              return PathFilter::PARTIAL;
+            }
+            return PathFilter::FULL;
+          }
+          PathFilter::Match match = filter->match(candidates[depth], key, indexes[depth], next);
+          if(match == PathFilter::FULL)
+          {
+            actions[depth] = (events ? EMIT : KEEP);
+          }
+          else if(match == PathFilter::PARTIAL && isContainer)
+          {
+            actions[depth] = (events ? DROP : KEEP);
+          }
+          else
+          {
+            actions[depth] = DROP;
+            match = PathFilter::NONE;
+          }
+          return match;
+        }
+
+        /**
+         * the container that began with match is open at depth
+         */
+        void open(std::size_t depth, PathFilter::Match match)
+        {
+          if(match == PathFilter::FULL)
+          {
+            if(filtering(depth))
+            {
+              // all nodes below are kept
+              fullDepth = depth;
+            }
+            return;
+          }
+          if(candidates.size() <= depth)
+          {
+            candidates.resize(depth + 1);
+            indexes.resize(depth + 1);
+            actions.resize(depth + 1);
+          }
+          candidates[depth].swap(next);
+          indexes[depth] = 0;
+        }
+
+        /**
+         * the container at depth is complete
+         */
+        void close(std::size_t depth)
+        {
+          if(depth == fullDepth)
+          {
+            fullDepth = std::numeric_limits<std::size_t>::max();
+          }
+        }
+
+        /**
+         * action for the completed child of the container at depth
+         */
+        Action action(std::size_t depth) const
+        {
+          return (filtering(depth) ? Action(actions[depth]) : KEEP);
+        }
+
+        /**
+         * an element of the array at depth is complete
+         */
+        void nextElement(std::size_t depth)
+        {
+          if(filtering(depth))
+          {
+            indexes[depth]++;
+          }
+        }
+
+        /**
+         * index of the current element of the filtered array at depth
+         */
+        std::size_t index(std::size_t depth) const
+        {
+          return indexes[depth];
+        }
+
+        std::size_t retainedBytes() const
+        {
+          return (candidates.capacity() * sizeof(std::vector<PathFilter::Candidate>) +
+                  next.capacity() * sizeof(PathFilter::Candidate) +
+                  indexes.capacity() * sizeof(std::size_t) +
+                  actions.capacity());
+        }
+
+        /**
+         * release buffers deeper than maxDepth
+         */
+        void shrink(std::size_t maxDepth)
+        {
+          release(candidates, maxDepth);
+          release(next, maxDepth);
+          release(indexes, maxDepth);
+          release(actions, maxDepth);
+        }
+
+      private:
+        const PathFilter * filter;
+        bool events;
+        std::vector<std::vector<PathFilter::Candidate>> candidates;
+        // candidates of the value that begins
+        std::vector<PathFilter::Candidate> next;
+        std::vector<std::size_t> indexes;
+        std::vector<char> actions;
+
+        // depth of the container below which all nodes are kept
+        std::size_t fullDepth;
+
+        template<typename T>
+        static void release(T & buffer, std::size_t maxCapacity)
+        {
+          if(buffer.capacity() > maxCapacity)
+          {
+            T().swap(buffer);
+          }
+        }
+      };
+    }
+  }
+}
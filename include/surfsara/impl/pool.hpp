@@ -0,0 +1,243 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace details
+    {
+      /**
+       * number of PayloadPoolScope instances on the calling thread
+       */
+      inline std::size_t & payloadPoolDepth()
+      {
+        static thread_local std::size_t depth = 0;
+        return depth;
+      }
+
+      /**
+       * Free list allocator for objects of type T.
+       * Each thread allocates from its own free list without locking,
+       * the list is refilled from slabs of BLOCKS objects.
+       * Blocks freed on another thread join that thread's list,
+       * the lists of finished threads and the surplus of long lists
+       * are adopted by other threads, at most BLOCKS at a time.
+       * Slabs are never returned to the global allocator, so the pool
+       * is only used within a PayloadPoolScope.
+       */
+      template<typename T, std::size_t BLOCKS = 256>
+      class SlabPool
+      {
+      public:
+        static void * allocate()
+        {
+          Cache & c(cache());
+          if(c.head == nullptr)
+          {
+            refill(c);
+          }
+          Block * b = c.head;
+          c.head = b->next;
+          c.cached--;
+          c.allocations++;
+          return b;
+        }
+
+        static void deallocate(void * p)
+        {
+          Block * b = static_cast<Block*>(p);
+          Cache & c(cache());
+          if(c.finished)
+          {
+            // thread local storage is gone, e.g. a static node
+            Shared & s(shared());
+            std::lock_guard<std::mutex> lock(s.mutex);
+            b->next = s.orphans;
+            s.orphans = b;
+            s.orphanCount++;
+          }
+          else
+          {
+            b->next = c.head;
+            c.head = b;
+            c.cached++;
+            c.deallocations++;
+            if(c.cached >= 4 * BLOCKS)
+            {
+              // a thread that mostly frees, e.g. a reclaimer,
+              // passes blocks on to the allocating threads
+              trim(c, 2 * BLOCKS);
+            }
+          }
+        }
+
+        static PoolStatistics statistics()
+        {
+          Cache & c(cache());
+          Shared & s(shared());
+          PoolStatistics ret;
+          ret.blockSize = sizeof(Block);
+          ret.allocations = c.allocations;
+          ret.deallocations = c.deallocations;
+          ret.cached = c.cached;
+          std::lock_guard<std::mutex> lock(s.mutex);
+          ret.slabs = s.slabs;
+          ret.orphaned = s.orphanCount;
+          ret.bytesReserved = s.slabs * BLOCKS * sizeof(Block);
+          return ret;
+        }
+
+      private:
+        union Block
+        {
+          Block * next;
+          typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+        };
+
+        // trivially destructible, so it stays usable for objects
+        // destroyed after the thread's other thread local storage
+        struct Cache
+        {
+          Block * head = nullptr;
+          std::size_t cached = 0;
+          std::size_t allocations = 0;
+          std::size_t deallocations = 0;
+          bool finished = false;
+        };
+        static_assert(std::is_trivially_destructible<Cache>::value,
+                      "the cache is read after the thread's destructors ran");
+
+        // hands the cached blocks to other threads when the thread ends
+        struct Guard
+        {
+          Cache & c;
+
+          ~Guard()
+          {
+            if(c.head != nullptr)
+            {
+              Shared & s(shared());
+              std::lock_guard<std::mutex> lock(s.mutex);
+              Block * last = c.head;
+              while(last->next != nullptr)
+              {
+                last = last->next;
+              }
+              last->next = s.orphans;
+              s.orphans = c.head;
+              s.orphanCount += c.cached;
+            }
+            c.head = nullptr;
+            c.cached = 0;
+            c.finished = true;
+          }
+        };
+
+        struct Shared
+        {
+          std::mutex mutex;
+          Block * orphans = nullptr;
+          std::size_t orphanCount = 0;
+          std::size_t slabs = 0;
+        };
+
+        static Cache & cache()
+        {
+          static thread_local Cache c;
+          static thread_local Guard guard{c};
+          (void)guard;
+          return c;
+        }
+
+        static Shared & shared()
+        {
+          // never destroyed, blocks may be released during static destruction
+          static Shared * s = new Shared();
+          return *s;
+        }
+
+        static void trim(Cache & c, std::size_t n)
+        {
+          Block * first = c.head;
+          Block * last = first;
+          for(std::size_t i = 1; i < n; i++)
+          {
+            last = last->next;
+          }
+          c.head = last->next;
+          c.cached -= n;
+          Shared & s(shared());
+          std::lock_guard<std::mutex> lock(s.mutex);
+          last->next = s.orphans;
+          s.orphans = first;
+          s.orphanCount += n;
+        }
+
+        static void refill(Cache & c)
+        {
+          Shared & s(shared());
+          std::lock_guard<std::mutex> lock(s.mutex);
+          if(s.orphans != nullptr)
+          {
+            // the rest stays available to other threads
+            Block * last = s.orphans;
+            std::size_t n = 1;
+            while(n < BLOCKS && last->next != nullptr)
+            {
+              last = last->next;
+              n++;
+            }
+            c.head = s.orphans;
+            c.cached += n;
+            s.orphans = last->next;
+            s.orphanCount -= n;
+            last->next = nullptr;
+            return;
+          }
+          Block * slab = static_cast<Block*>(::operator new(BLOCKS * sizeof(Block)));
+          for(std::size_t i = 0; i + 1 < BLOCKS; i++)
+          {
+            slab[i].next = &slab[i + 1];
+          }
+          slab[BLOCKS - 1].next = nullptr;
+          c.head = slab;
+          c.cached += BLOCKS;
+          s.slabs++;
+        }
+      };
+    }
+  }
+}
@@ -0,0 +1,105 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <surfsara/reclaimer.h>
+
+inline surfsara::ast::Reclaimer::Reclaimer()
+  : count(0), busy(false), stopping(false)
+{
+  thread = std::thread(&Reclaimer::run, this);
+}
+
+inline surfsara::ast::Reclaimer::~Reclaimer()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wakeup.notify_one();
+  thread.join();
+}
+
+inline void surfsara::ast::Reclaimer::reclaim(Node && node)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(std::move(node));
+  }
+  wakeup.notify_one();
+}
+
+inline void surfsara::ast::Reclaimer::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this](){ return pending.empty() && !busy; });
+}
+
+inline std::size_t surfsara::ast::Reclaimer::reclaimed() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return count;
+}
+
+inline surfsara::ast::Reclaimer & surfsara::ast::Reclaimer::global()
+{
+  static Reclaimer reclaimer;
+  return reclaimer;
+}
+
+inline void surfsara::ast::Reclaimer::run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while(true)
+  {
+    wakeup.wait(lock, [this](){ return stopping || !pending.empty(); });
+    if(pending.empty())
+    {
+      break;
+    }
+    std::vector<Node> batch;
+    batch.swap(pending);
+    busy = true;
+    lock.unlock();
+    std::size_t n = batch.size();
+    batch.clear();
+    lock.lock();
+    busy = false;
+    count += n;
+    if(pending.empty())
+    {
+      idle.notify_all();
+    }
+  }
+}
+
+inline void surfsara::ast::deferredDestroy(Node && node)
+{
+  Reclaimer::global().reclaim(std::move(node));
+}
@@ -0,0 +1,283 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <cstddef>
+#include <typeindex>
+#include <typeinfo>
+#include <vector>
+#include <surfsara/ast.h>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace detail
+    {
+      /**
+       * payloads of a previous tree that the parser takes over as far
+       * as the next document has the same shape, see parseInto().
+       * For each open container it keeps the number of old elements
+       * and the position of the next one.
+       */
+      class Recycler
+      {
+      public:
+        typedef Node::Value Value;
+
+        Recycler() : recycling(false), reuse(Null())
+        {
+        }
+
+        /**
+         * the root of the next document reuses old
+         */
+        void start(Value && old)
+        {
+          reuse = std::move(old);
+          recycling = true;
+        }
+
+        bool active() const
+        {
+          return recycling;
+        }
+
+        void reset()
+        {
+          recycling = false;
+          reuse = Value(Null());
+        }
+
+        /**
+         * true if the old value at the current position has a
+         * string, array or object payload of the given type
+         */
+        bool reusable(const std::type_index & type) const
+        {
+          return recycling && canReuse(reuse, type);
+        }
+
+        /**
+         * the old value at the current position, see reusable()
+         */
+        Value take()
+        {
+          return std::move(reuse);
+        }
+
+        /**
+         * the old member of the object at depth with the key of the value that
+         * begins, if the shape differs the remaining members are not reused
+         */
+        void takeMember(std::size_t depth, Object & obj, const String & key)
+        {
+          Recycled & r(recycled[depth]);
+          r.matched = (r.member != obj.end() && r.member->first == key);
+          if(r.matched)
+          {
+            reuse = r.member->second.release();
+            return;
+          }
+          trim(r, obj);
+          reuse = Value(Null());
+        }
+
+        /**
+         * the old element of the array at depth at the position of the value that begins
+         */
+        void takeElement(std::size_t depth, Array & arr)
+        {
+          Recycled & r(recycled[depth]);
+          if(r.next < r.size)
+          {
+            reuse = arr.unsafeAt(r.next).release();
+            return;
+          }
+          reuse = Value(Null());
+        }
+
+        /**
+         * the array or object container is open at depth, its old
+         * elements are overwritten by the new ones
+         */
+        void open(std::size_t depth, Value & container)
+        {
+          if(!recycling)
+          {
+            return;
+          }
+          if(recycled.size() <= depth)
+          {
+            recycled.resize(depth + 1);
+          }
+          Recycled & r(recycled[depth]);
+          r.next = 0;
+          r.matched = false;
+          if(container.isA<Array>())
+          {
+            r.size = container.as<Array>().size();
+          }
+          else
+          {
+            r.size = 0;
+            r.member = container.as<Object>().begin();
+          }
+        }
+
+        /**
+         * the slot of the old element that the completed element
+         * of the array at depth overwrites, nullptr to append it
+         */
+        Node * element(std::size_t depth, Array & arr)
+        {
+          if(recycling && recycled[depth].next < recycled[depth].size)
+          {
+            return &arr.unsafeAt(recycled[depth].next);
+          }
+          return nullptr;
+        }
+
+        /**
+         * the slot of the old member with the key of the completed
+         * member of the object at depth, nullptr to add it
+         */
+        Node * member(std::size_t depth)
+        {
+          if(recycling && recycled[depth].matched)
+          {
+            Recycled & r(recycled[depth]);
+            return &(r.member++)->second;
+          }
+          return nullptr;
+        }
+
+        /**
+         * a child of the container at depth is complete
+         */
+        void next(std::size_t depth)
+        {
+          if(recycling)
+          {
+            recycled[depth].next++;
+            recycled[depth].matched = false;
+          }
+        }
+
+        /**
+         * drop the old elements or members of the complete
+         * container at depth that have not been overwritten
+         */
+        void close(std::size_t depth, Value & container)
+        {
+          if(!recycling)
+          {
+            return;
+          }
+          Recycled & r(recycled[depth]);
+          if(container.isA<Array>())
+          {
+            Array & arr(container.as<Array>());
+            while(arr.size() > r.next)
+            {
+              arr.remove(arr.size() - 1);
+            }
+          }
+          else
+          {
+            trim(r, container.as<Object>());
+          }
+        }
+
+        std::size_t retainedBytes() const
+        {
+          return recycled.capacity() * sizeof(Recycled);
+        }
+
+        /**
+         * release the buffer if it is deeper than maxDepth
+         */
+        void shrink(std::size_t maxDepth)
+        {
+          if(recycled.capacity() > maxDepth)
+          {
+            std::vector<Recycled>().swap(recycled);
+          }
+        }
+
+      private:
+        struct Recycled
+        {
+          std::size_t size;
+          std::size_t next;
+          Object::iterator member;
+          bool matched;
+        };
+        bool recycling;
+        Value reuse;
+        std::vector<Recycled> recycled;
+
+        /**
+         * true if the string, array or object payload of v
+         * can be taken over by the parser
+         */
+        static bool canReuse(const Value & v, const std::type_index & type)
+        {
+          if(v.typeIndex != type || v.isShared())
+          {
+            return false;
+          }
+          else if(type == typeid(String))
+          {
+            return !v.v.stringValue->inArena;
+          }
+          else if(type == typeid(Array))
+          {
+            return !v.v.arrayValue->inArena;
+          }
+          else
+          {
+            return !v.v.objectValue->inArena;
+          }
+        }
+
+        static void trim(Recycled & r, Object & obj)
+        {
+          if(r.member != obj.end())
+          {
+            std::size_t pos = 0;
+            std::size_t keep = r.next;
+            obj.remove([&pos, keep](const String &, const Node &){ return pos++ >= keep; });
+            r.member = obj.end();
+          }
+        }
+      };
+    }
+  }
+}
@@ -0,0 +1,236 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <cstdint>
+#include <cstring>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    namespace detail
+    {
+      static const std::uint64_t wordOnes = 0x0101010101010101ull;
+      static const std::uint64_t wordHigh = 0x8080808080808080ull;
+
+      /**
+       * white space between tokens, shared by the parser and the validator
+       */
+      inline bool isWhiteSpace(char ch)
+      {
+        static const std::uint64_t spaces = ((std::uint64_t(1) << ' ') | (std::uint64_t(1) << '\r') |
+                                             (std::uint64_t(1) << '\n') | (std::uint64_t(1) << '\t') |
+                                             (std::uint64_t(1) << '\v') | (std::uint64_t(1) << '\f'));
+        unsigned char c = ch;
+        return c <= ' ' && ((spaces >> c) & 1u);
+      }
+
+      inline bool isDigit(char ch)
+      {
+        return ch >= '0' && ch <= '9';
+      }
+
+      /**
+       * the character after a backslash, the parser drops the others
+       */
+      inline bool isEscape(char ch)
+      {
+        return (ch == '"' || ch == '\\' || ch == '/' || ch == 'b' || ch == 'f' ||
+                ch == 'n' || ch == 'r' || ch == 't' || ch == 'u');
+      }
+
+      /**
+       * true if one of the eight bytes is a quote,
+       * a backslash or a control character
+       */
+      inline bool hasStringSpecial(std::uint64_t x)
+      {
+        std::uint64_t quote = x ^ (wordOnes * '"');
+        std::uint64_t backslash = x ^ (wordOnes * '\\');
+        return (((quote - wordOnes) & ~quote) |
+                ((backslash - wordOnes) & ~backslash) |
+                ((x - wordOnes * 0x20) & ~x)) & wordHigh;
+      }
+
+      /**
+       * value of a hex digit, -1 for other characters
+       */
+      inline int hexValue(char ch)
+      {
+        if(ch >= '0' && ch <= '9') return ch - '0';
+        if(ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+        if(ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+        return -1;
+      }
+
+      /**
+       * value of four hex digits, -1 if one of them is not a hex digit
+       */
+      inline long hexValue4(const char * p)
+      {
+        int a = hexValue(p[0]);
+        int b = hexValue(p[1]);
+        int c = hexValue(p[2]);
+        int d = hexValue(p[3]);
+        if((a | b | c | d) < 0)
+        {
+          return -1;
+        }
+        return (long(a) << 12) | (b << 8) | (c << 4) | d;
+      }
+
+      /**
+       * append the UTF-8 encoding of a code point
+       */
+      template<typename S>
+      inline void appendUtf8(S & target, std::uint32_t u)
+      {
+        if(u < 0x80)
+        {
+          target.push_back(char(u));
+        }
+        else if(u < 0x800)
+        {
+          char buf[2] = {char((u >> 6) | 0xc0), char((u & 0x3f) | 0x80)};
+          target.append(buf, 2);
+        }
+        else if(u < 0x10000)
+        {
+          char buf[3] = {char((u >> 12) | 0xe0), char(((u >> 6) & 0x3f) | 0x80), char((u & 0x3f) | 0x80)};
+          target.append(buf, 3);
+        }
+        else
+        {
+          char buf[4] = {char((u >> 18) | 0xf0), char(((u >> 12) & 0x3f) | 0x80),
+                         char(((u >> 6) & 0x3f) | 0x80), char((u & 0x3f) | 0x80)};
+          target.append(buf, 4);
+        }
+      }
+
+      /**
+       * incremental UTF-8 check, a sequence may be split between calls
+       */
+      class Utf8Checker
+      {
+      public:
+        Utf8Checker() : need(0), lo(0x80), hi(0xbf)
+        {
+        }
+
+        void reset()
+        {
+          need = 0;
+        }
+
+        /**
+         * false if the sequence is complete
+         */
+        bool pending() const
+        {
+          return need != 0;
+        }
+
+        /**
+         * false if ch cannot follow the preceding bytes
+         */
+        bool next(unsigned char ch)
+        {
+          if(need == 0)
+          {
+            if(ch < 0x80) return true;
+            else if(ch >= 0xc2 && ch <= 0xdf) start(1, 0x80, 0xbf);
+            else if(ch == 0xe0) start(2, 0xa0, 0xbf);
+            else if(ch == 0xed) start(2, 0x80, 0x9f);
+            else if(ch >= 0xe1 && ch <= 0xef) start(2, 0x80, 0xbf);
+            else if(ch == 0xf0) start(3, 0x90, 0xbf);
+            else if(ch >= 0xf1 && ch <= 0xf3) start(3, 0x80, 0xbf);
+            else if(ch == 0xf4) start(3, 0x80, 0x8f);
+            else return false;
+            return true;
+          }
+          if(ch < lo || ch > hi)
+          {
+            return false;
+          }
+          need--;
+          lo = 0x80;
+          hi = 0xbf;
+          return true;
+        }
+
+        /**
+         * returns the first invalid byte, end if there is none,
+         * ASCII runs are skipped eight bytes at a time
+         */
+        const char * scan(const char * begin, const char * end)
+        {
+          while(begin != end)
+          {
+            if(need == 0)
+            {
+              while(end - begin >= 8)
+              {
+                std::uint64_t x;
+                std::memcpy(&x, begin, 8);
+                if(x & wordHigh)
+                {
+                  break;
+                }
+                begin += 8;
+              }
+              if(begin == end)
+              {
+                break;
+              }
+            }
+            if(!next(*begin))
+            {
+              return begin;
+            }
+            ++begin;
+          }
+          return end;
+        }
+
+      private:
+        void start(unsigned _need, unsigned char _lo, unsigned char _hi)
+        {
+          need = _need;
+          lo = _lo;
+          hi = _hi;
+        }
+
+        unsigned need;
+        unsigned char lo;
+        unsigned char hi;
+      };
+    }
+  }
+}
@@ -0,0 +1,118 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+/////////////////////////////////////////////////////
+//
+// implementation details don't include directly.
+//
+/////////////////////////////////////////////////////
+#include <surfsara/string_pool.h>
+
+inline surfsara::ast::StringPool::StringPool(std::size_t maxLength, std::size_t maxEntries)
+  : lengthLimit(maxLength), entryLimit(maxEntries)
+{
+}
+
+inline surfsara::ast::Node surfsara::ast::StringPool::intern(const String & str)
+{
+  return Node(internValue(str));
+}
+
+inline surfsara::ast::Node::Value surfsara::ast::StringPool::internValue(const String & str)
+{
+  if(str.size() <= lengthLimit)
+  {
+    std::size_t h = std::hash<String>()(str);
+    Node::Value ret = Null();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = table.equal_range(h);
+    for(auto itr = range.first; itr != range.second; ++itr)
+    {
+      const Node::Value & entry(itr->second);
+      if(entry.as<String>() == str)
+      {
+        ret.shareFrom(entry);
+        return ret;
+      }
+    }
+    if(table.size() < entryLimit)
+    {
+      Node::Value entry(str);
+      entry.share();
+      ret.shareFrom(entry);
+      table.emplace(h, std::move(entry));
+      return ret;
+    }
+  }
+  return Node::Value(str);
+}
+
+inline surfsara::ast::Key surfsara::ast::StringPool::key(const String & str)
+{
+  if(str.size() <= lengthLimit)
+  {
+    std::size_t h = Object::hashKey(str);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = keys.equal_range(h);
+    for(auto itr = range.first; itr != range.second; ++itr)
+    {
+      if(itr->second->text == str)
+      {
+        return Key(itr->second);
+      }
+    }
+    if(keys.size() < entryLimit)
+    {
+      std::shared_ptr<const details::KeyPayload> entry(std::make_shared<const details::KeyPayload>(str, h));
+      keys.emplace(h, entry);
+      return Key(std::move(entry));
+    }
+    return Key(std::make_shared<const details::KeyPayload>(str, h));
+  }
+  return Key(str);
+}
+
+inline std::size_t surfsara::ast::StringPool::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return table.size();
+}
+
+inline std::size_t surfsara::ast::StringPool::keyCount() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return keys.size();
+}
+
+inline std::size_t surfsara::ast::StringPool::maxLength() const
+{
+  return lengthLimit;
+}
+
+inline surfsara::ast::StringPool & surfsara::ast::StringPool::global()
+{
+  static StringPool pool;
+  return pool;
+}
@@ -0,0 +1,152 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+#include "ast.h"
+#include "json_parser.h"
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    /**
+     * Parse one large document on several threads. The input is
+     * split into chunks, each thread works out the string and
+     * bracket state of its chunk for both possible starting states,
+     * the chunks are then cut at commas between top-level elements
+     * and parsed concurrently, the partial arrays or objects are
+     * concatenated. Inputs that are not an array or object, or
+     * too small to split, are parsed by parseJson().
+     * threads = 0 uses the number of hardware threads.
+     */
+    inline Node parseJsonParallel(const std::string & str,
+                                  std::size_t threads = 0,
+                                  const ParseOptions & options = ParseOptions());
+
+    /**
+     * Fixed set of threads that parse batches of independent documents.
+     * Each thread keeps one parser whose buffers are reused from
+     * document to document. A batch is split into one range of
+     * documents per thread, a thread that runs out of work takes half
+     * of the remaining range of another one. The results are in input
+     * order, the first error in input order is rethrown after the
+     * whole batch has been processed. Concurrent batches are run
+     * one after the other.
+     */
+    class ParserPool
+    {
+    public:
+      /**
+       * threads = 0 uses the number of hardware threads
+       */
+      inline explicit ParserPool(std::size_t threads = 0, const ParseOptions & options = ParseOptions());
+      ParserPool(const ParserPool &) = delete;
+      ParserPool & operator=(const ParserPool &) = delete;
+      inline ~ParserPool();
+
+      inline std::size_t size() const;
+
+      /**
+       * parse each document, the documents must outlive
+       * the results if options.borrow is set
+       */
+      inline std::vector<Node> parse(const std::vector<std::string> & documents);
+
+      /**
+       * parse the content of each file, strings are never borrowed
+       */
+      inline std::vector<Node> parseFiles(const std::vector<std::string> & files);
+
+      /**
+       * one batch with other options on at most threads of the
+       * pool's threads, threads = 0 uses all of them
+       */
+      inline std::vector<Node> parse(const std::vector<std::string> & documents,
+                                     const ParseOptions & options,
+                                     std::size_t threads = 0);
+      inline std::vector<Node> parseFiles(const std::vector<std::string> & files,
+                                          const ParseOptions & options,
+                                          std::size_t threads = 0);
+
+      /**
+       * process wide pool with one thread per hardware thread,
+       * created on first use
+       */
+      inline static ParserPool & shared();
+
+    private:
+      struct Worker;
+      typedef std::function<Node(Worker & worker, std::size_t i)> Task;
+
+      inline void run(std::size_t n, const Task & task, std::vector<Node> & results,
+                      const ParseOptions & options, std::size_t threads);
+      inline void work(std::size_t i);
+      inline bool next(std::size_t i, std::size_t & item);
+
+      ParseOptions options;
+      std::vector<std::unique_ptr<Worker>> workers;
+      std::vector<std::thread> threads;
+      // held for a whole batch
+      std::mutex batch;
+      std::mutex mutex;
+      std::condition_variable wake;
+      std::condition_variable done;
+
+      // current batch
+      const Task * task;
+      std::vector<Node> * results;
+      const ParseOptions * batchOptions;
+      std::vector<std::exception_ptr> errors;
+      std::size_t active;
+      std::size_t generation;
+      std::size_t busy;
+      bool stop;
+    };
+
+    /**
+     * parse independent documents on ParserPool::shared(),
+     * threads is capped at the size of that pool
+     */
+    inline std::vector<Node> parseJsonBatch(const std::vector<std::string> & documents,
+                                            std::size_t threads = 0,
+                                            const ParseOptions & options = ParseOptions());
+
+    /**
+     * parse the content of each file on ParserPool::shared()
+     */
+    inline std::vector<Node> parseJsonFiles(const std::vector<std::string> & files,
+                                            std::size_t threads = 0,
+                                            const ParseOptions & options = ParseOptions());
+  }
+}
+
+#include "impl/json_parallel.hpp"
@@ -23,22 +23,192 @@ SOFTWARE.
 */
 #pragma once
 #include "ast.h"
+#include "string_pool.h"
 #include <iostream>
 #include <string>
 #include <sstream>
 
 #include <vector>
 #include <map>
+#include <memory>
+#include <set>
 #include <iostream>
 
 namespace surfsara
 {
   namespace ast
   {
+    struct ParseOptions
+    {
+      /**
+       * compute Node::hash() of each array and object
+       * while parsing, the hashes are cached in the containers
+       * until they are modified through a non-const member
+       */
+      bool hash = false;
+
+      /**
+       * share equal strings, arrays and objects, see Node::dedupe()
+       */
+      bool dedupe = false;
+
+      /**
+       * release the unused capacity of strings, arrays and
+       * object indexes as soon as they are complete, see Node::compact()
+       */
+      bool compact = false;
+
+      /**
+       * take the payloads of the tree from thread local free lists,
+       * see PayloadPoolScope
+       */
+      bool poolPayloads = false;
+
+      /**
+       * intern string values and object keys up to the pool's maximum
+       * length. Equal short string values share one payload. Members are
+       * indexed with the hashes of the interned keys, but each member
+       * still holds a copy of its key.
+       */
+      StringPool * strings = nullptr;
+
+      /**
+       * string values without escape sequences reference the input
+       * instead of copying it, the input must outlive the tree.
+       * Only applies when the input is one contiguous buffer,
+       * copies of such strings are independent of the input.
+       * Node::stringData() reads them without copying, the first
+       * as<String>() const copies the text into the node.
+       */
+      bool borrow = false;
+
+      /**
+       * reject strings and keys that are not valid UTF-8, the error
+       * message gives the offset of the first invalid byte.
+       * Runs of ASCII characters are checked eight bytes at a time.
+       */
+      bool validateUtf8 = false;
+
+      /**
+       * keep the text of numbers and convert it on first access,
+       * formatJson() writes such numbers exactly as they were read.
+       * Range errors are reported on access instead of while parsing.
+       */
+      bool lazyNumbers = false;
+
+      /**
+       * consume the keys of an object with one comparison when they
+       * repeat the keys of the previous object at the same depth
+       */
+      bool predictKeys = true;
+
+      /**
+       * arrays and objects nested deeper than deferDepth are only
+       * scanned for their closing bracket and kept as text, they are
+       * parsed on first access, one level at a time, into the arena
+       * of the Document that holds them. 0 disables it. The text is
+       * checked while parsing, formatJson() writes it without
+       * parsing it.
+       */
+      std::size_t deferDepth = 0;
+
+      /**
+       * arrays and objects that are the value of one of these keys
+       * are deferred regardless of their depth
+       */
+      std::set<std::string> deferKeys;
+    };
+
+    namespace detail
+    {
+      class Parser;
+    }
+
+    /**
+     * Parser for a sequence of documents. Between documents it keeps
+     * the capacity of its stacks and string buffers and the table of
+     * the deduplicator, so small documents hardly allocate anything
+     * besides the tree. parseJson() uses one parser per thread.
+     */
+    class Parser
+    {
+    public:
+      inline explicit Parser(const ParseOptions & options = ParseOptions());
+      inline ~Parser();
+      Parser(const Parser &) = delete;
+      Parser & operator=(const Parser &) = delete;
+
+      /**
+       * drop the document being parsed
+       */
+      inline void reset();
+
+      /**
+       * drop the document being parsed, the following ones use options
+       */
+      inline void reset(const ParseOptions & options);
+
+      /**
+       * parse the next part of the current document,
+       * after an error the document must be reset
+       */
+      inline void parseChunk(const char * str, std::size_t n);
+
+      /**
+       * end of the current document, the next chunk starts a new one
+       */
+      inline Node finish();
+
+      /**
+       * parse a complete document, a partial one is dropped
+       */
+      inline Node parse(const std::string & str);
+      inline Node parse(const char * str, std::size_t n);
+
+      /**
+       * parse a complete document into target, see parseInto()
+       */
+      inline void parseInto(Node & target, const std::string & str);
+      inline void parseInto(Node & target, const char * str, std::size_t n);
+
+    private:
+      std::unique_ptr<detail::Parser> impl;
+    };
+
     inline Node parseJson(const std::string & str);
+    inline Node parseJson(const std::string & str, const ParseOptions & options);
+
+    /**
+     * build only the nodes on or below one of the paths, which use
+     * the syntax of Node::find(). Everything else is checked like the
+     * rest of the document but no nodes are built for it, except that
+     * array elements off the paths are kept as Undefined so that
+     * indexes stay valid. A "#" keeps all elements.
+     */
+    inline Node parseJson(const std::string & str, const std::vector<std::string> & paths);
+    inline Node parseJson(const std::string & str,
+                          const std::vector<std::string> & paths,
+                          const ParseOptions & options);
+
+    /**
+     * Parse str into target. The strings, arrays and objects of the
+     * previous content of target are reused where the document has
+     * the same shape: array elements by position, object members if
+     * the key matches the key at the same position. Parsing a stream
+     * of similar messages into one node then hardly allocates.
+     * target is null after a syntax error.
+     */
+    inline void parseInto(Node & target, const std::string & str);
+    inline void parseInto(Node & target, const std::string & str, const ParseOptions & options);
+
+    // not a candidate for parseJson(str, {"a/b", "c"})
+    template<typename I>
+    inline typename std::enable_if<!std::is_same<I, std::string>::value, Node>::type
+    parseJson(I & begin, const I & end);
 
     template<typename I>
-    inline Node parseJson(I & begin, const I & end);
+    inline typename std::enable_if<!std::is_same<I, std::string>::value, Node>::type
+    parseJson(I & begin, const I & end, const ParseOptions & options);
   }
 }
 
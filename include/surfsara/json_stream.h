@@ -0,0 +1,211 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+#include "ast.h"
+#include "json_parser.h"
+#include "json_format.h"
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    /**
+     * receives a matching node and its path, returning false
+     * stops reading the input
+     */
+    typedef std::function<bool(const Node & node,
+                               const std::vector<std::string> & path)> StreamCallback;
+
+    /**
+     * Calls callback for each node matching path, in the syntax of
+     * Node::find(), in document order. The document is not built,
+     * memory is bounded by the largest match. Returns the number of
+     * matches passed to the callback.
+     */
+    inline std::size_t streamFind(std::istream & ist,
+                                  const std::string & path,
+                                  const StreamCallback & callback,
+                                  const ParseOptions & options = ParseOptions());
+
+    /**
+     * same for a buffer, with ParseOptions::borrow the matches
+     * reference the buffer
+     */
+    inline std::size_t streamFind(const char * str,
+                                  std::size_t n,
+                                  const std::string & path,
+                                  const StreamCallback & callback,
+                                  const ParseOptions & options = ParseOptions());
+
+    /**
+     * Reads the elements of a top-level array one at a time from a
+     * stream or buffer. Memory is proportional to one element, the
+     * parser state is reused for all elements.
+     *
+     * ArrayReader reader(ist);
+     * for(Node & record : reader) { ... }
+     */
+    class ArrayReader
+    {
+    public:
+      class iterator;
+
+      explicit ArrayReader(std::istream & ist, const ParseOptions & options = ParseOptions());
+
+      /**
+       * with ParseOptions::borrow the elements reference the buffer
+       */
+      ArrayReader(const char * str, std::size_t n, const ParseOptions & options = ParseOptions());
+
+      ArrayReader(const ArrayReader &) = delete;
+      ArrayReader & operator=(const ArrayReader &) = delete;
+
+      /**
+       * move the next element into node,
+       * returns false after the last element
+       */
+      inline bool next(Node & node);
+
+      inline iterator begin();
+      inline iterator end();
+
+      class iterator
+      {
+      public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef Node value_type;
+        typedef Node & reference;
+        typedef Node * pointer;
+        typedef std::ptrdiff_t difference_type;
+
+        iterator() : reader(nullptr) {}
+        explicit iterator(ArrayReader * _reader) : reader(_reader)
+        {
+          ++(*this);
+        }
+
+        Node & operator*()
+        {
+          return current;
+        }
+
+        Node * operator->()
+        {
+          return &current;
+        }
+
+        iterator & operator++()
+        {
+          if(reader && !reader->next(current))
+          {
+            reader = nullptr;
+          }
+          return *this;
+        }
+
+        bool operator==(const iterator & rhs) const
+        {
+          return reader == rhs.reader;
+        }
+
+        bool operator!=(const iterator & rhs) const
+        {
+          return reader != rhs.reader;
+        }
+
+      private:
+        ArrayReader * reader;
+        Node current;
+      };
+
+    private:
+      inline bool fill();
+      inline bool callback(Node & node);
+
+      std::istream * ist;
+      std::vector<char> buffer;
+      const char * data;
+      std::size_t size;
+      std::size_t pos;
+      bool started;
+      bool finished;
+      detail::PathFilter filter;
+      detail::Parser parser;
+      Node current;
+    };
+
+    /**
+     * Applies update and remove rules to JSON text and writes the
+     * result without building the document. Paths have the syntax
+     * and semantics of Node::update() and Node::remove(), including
+     * "*" and "#". Rules are applied in the order they were added,
+     * an array index refers to the array left by the earlier rules.
+     * A rule that follows the update or removal of a value applies
+     * to the replacement, e.g. it re-inserts a removed member. Paths
+     * the tree rejects throw PathError, an index past the end of an
+     * array once the end is reached. The input is checked like
+     * parseJson() does, including the values that are copied or
+     * dropped. Only the replacement values are held in memory, the
+     * output is compact.
+     */
+    class JsonRewriter
+    {
+    public:
+      struct Rule
+      {
+        std::vector<std::string> path;
+        bool remove;
+        Node value;
+        bool insert;
+      };
+
+      /**
+       * replace the nodes at path by value, with insert missing
+       * object members are added and "#" appends to arrays
+       */
+      inline JsonRewriter & update(const std::string & path, const Node & value, bool insert = true);
+
+      /**
+       * drop the nodes at path
+       */
+      inline JsonRewriter & remove(const std::string & path);
+
+      inline void rewrite(std::istream & ist, std::ostream & ost) const;
+      inline void rewrite(const char * str, std::size_t n, std::ostream & ost) const;
+      inline std::string rewrite(const std::string & str) const;
+
+    private:
+      std::vector<Rule> rules;
+    };
+  }
+}
+
+#include "impl/json_stream.hpp"
@@ -0,0 +1,152 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    /**
+     * outcome of validateJson(), for invalid input the byte offset
+     * and a description of the first error
+     */
+    struct ValidationResult
+    {
+      bool valid;
+      std::size_t offset;
+      const char * message;
+
+      explicit operator bool() const
+      {
+        return valid;
+      }
+    };
+
+    /**
+     * Accepts exactly the documents that parseJson() accepts with the
+     * default options, without building nodes. Whitespace, numbers,
+     * escapes and strings follow the parser, numbers are checked for
+     * the range of Integer and Float like the parser does. String
+     * contents are scanned eight bytes at a time. Memory is only
+     * allocated for nesting deeper than 4096 levels and for numbers
+     * that are split between chunks or long enough to need a
+     * conversion. The input may be passed in chunks of any size.
+     */
+    class JsonValidator
+    {
+    public:
+      inline JsonValidator();
+
+      /**
+       * start a new document
+       */
+      inline void reset();
+
+      /**
+       * check the next chunk, returns false once an error was found
+       */
+      inline bool feed(const char * str, std::size_t n);
+
+      /**
+       * check the next chunk up to the end of the first value,
+       * returns the number of bytes consumed. Used to skip a value
+       * embedded in a larger document, see complete().
+       */
+      inline std::size_t feedValue(const char * str, std::size_t n);
+
+      /**
+       * true if a complete value was checked, the characters
+       * that may follow it have not been checked
+       */
+      inline bool complete() const;
+
+      /**
+       * end of the input
+       */
+      inline ValidationResult finish();
+
+      /**
+       * the first error, valid if none was found yet
+       */
+      inline const ValidationResult & result() const;
+
+    private:
+      enum State : char
+      {
+        VALUE,
+        ARRAY_FIRST,
+        OBJECT_FIRST,
+        KEY,
+        COLON,
+        AFTER,
+        STRING,
+        STRING_ESC,
+        STRING_HEX,
+        STRING_LOW,
+        STRING_LOW_U,
+        LITERAL,
+        NUM_DIGIT,
+        NUM_FRAC,
+        NUM_EXP,
+        NUM_EXP_DIGIT,
+        ERROR
+      };
+
+      template<bool SINGLE>
+      inline std::size_t check(const char * str, std::size_t n);
+      inline std::size_t beginValue(const char * str, std::size_t i);
+      inline std::size_t scanString(const char * str, std::size_t i, std::size_t n) const;
+      inline void endNumber(const char * str, std::size_t i, bool isFloat);
+      inline void push(bool isObject);
+      inline void pop(bool isObject, std::size_t i);
+      inline bool isObject(std::size_t d) const;
+      inline void fail(const char * msg, std::size_t i);
+
+      State state;
+      bool inKey;
+      bool lowPending;
+      const char * literal;
+      unsigned hexCount;
+      unsigned code;
+      std::size_t offset;
+      std::size_t depth;
+      // one bit per open container, set for objects
+      std::uint64_t containers[64];
+      std::vector<std::uint64_t> deepContainers;
+      // text of a number that started in a previous chunk
+      std::string number;
+      std::size_t numberStart;
+      ValidationResult error;
+    };
+
+    inline ValidationResult validateJson(const char * str, std::size_t n);
+    inline ValidationResult validateJson(const std::string & str);
+  }
+}
+
+#include "impl/json_validator.hpp"
@@ -0,0 +1,90 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+#include "ast.h"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    /**
+     * Destroys nodes on a background thread.
+     * Large trees handed over with reclaim() are freed without
+     * blocking the calling thread, the destructor waits until
+     * all pending nodes are destroyed.
+     */
+    class Reclaimer
+    {
+    public:
+      Reclaimer();
+      ~Reclaimer();
+      Reclaimer(const Reclaimer &) = delete;
+      Reclaimer & operator=(const Reclaimer &) = delete;
+
+      /**
+       * take over the node, it is left null
+       */
+      inline void reclaim(Node && node);
+
+      /**
+       * wait until all nodes handed over so far are destroyed
+       */
+      inline void flush();
+
+      /**
+       * number of nodes destroyed so far
+       */
+      inline std::size_t reclaimed() const;
+
+      /**
+       * process wide reclaimer, started on first use
+       */
+      inline static Reclaimer & global();
+
+    private:
+      inline void run();
+
+      mutable std::mutex mutex;
+      std::condition_variable wakeup;
+      std::condition_variable idle;
+      std::vector<Node> pending;
+      std::size_t count;
+      bool busy;
+      bool stopping;
+      std::thread thread;
+    };
+
+    /**
+     * hand the node over to the global reclaimer
+     */
+    inline void deferredDestroy(Node && node);
+  }
+}
+
+#include "impl/reclaimer.hpp"
@@ -0,0 +1,92 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+#include "ast.h"
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+namespace surfsara
+{
+  namespace ast
+  {
+    /**
+     * Thread safe intern table of short strings and object keys.
+     * Interned strings share one immutable payload, see Node::dedupe(),
+     * interned keys carry their hash, see Object::set(const Key &, ...).
+     * Objects keep their own copy of the key text, interning keys saves
+     * hashing, not memory per member.
+     * The pool keeps its entries alive until it is destroyed.
+     */
+    class StringPool
+    {
+    public:
+      /**
+       * strings longer than maxLength are not interned, the string
+       * and the key table each stop growing at maxEntries
+       */
+      explicit StringPool(std::size_t maxLength = 32, std::size_t maxEntries = 1u << 16);
+      StringPool(const StringPool &) = delete;
+      StringPool & operator=(const StringPool &) = delete;
+
+      /**
+       * node sharing the payload of the interned copy of str,
+       * a node with a private copy if str is not interned
+       */
+      inline Node intern(const String & str);
+
+      /**
+       * value form of intern() used by the parser
+       */
+      inline Node::Value internValue(const String & str);
+
+      /**
+       * key sharing the payload and hash of the interned copy of str,
+       * a key with its own payload if str is not interned
+       */
+      inline Key key(const String & str);
+
+      /**
+       * number of interned strings and of interned keys
+       */
+      inline std::size_t size() const;
+      inline std::size_t keyCount() const;
+      inline std::size_t maxLength() const;
+
+      /**
+       * process wide pool
+       */
+      inline static StringPool & global();
+
+    private:
+      std::size_t lengthLimit;
+      std::size_t entryLimit;
+      mutable std::mutex mutex;
+      std::unordered_multimap<std::size_t, Node::Value> table;
+      std::unordered_multimap<std::size_t, std::shared_ptr<const details::KeyPayload>> keys;
+    };
+  }
+}
+
+#include "impl/string_pool.hpp"
@@ -24,7 +24,12 @@ SOFTWARE.
 #include <catch2/catch.hpp>
 #include <surfsara/ast.h>
 #include <surfsara/json_format.h>
+#include <surfsara/reclaimer.h>
+#include <surfsara/string_pool.h>
 #include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <unordered_set>
+#include <thread>
 
 using namespace surfsara::ast;
 
@@ -332,6 +337,397 @@ TEST_CASE("array operations", "[Node]")
 }
 
 
+TEST_CASE("array iterators", "[Node]")
+{
+  Node n = Array{Integer(1), Integer(2), Integer(3)};
+  const Array & carr(n.as<Array>());
+  REQUIRE(std::distance(carr.begin(), carr.end()) == 3);
+  REQUIRE(std::count_if(carr.cbegin(), carr.cend(),
+                        [](const Node & node){ return node.as<Integer>() > 1; }) == 2);
+  Integer sum = 0;
+  for(const Node & node : carr)
+  {
+    sum += node.as<Integer>();
+  }
+  REQUIRE(sum == 6);
+  for(Node & node : n.as<Array>())
+  {
+    node = node.as<Integer>() * 10;
+  }
+  REQUIRE(formatJson(n) == "[10,20,30]");
+  REQUIRE(std::find(carr.begin(), carr.end(), Node(20)) - carr.begin() == 1);
+  REQUIRE(carr.rbegin()->as<Integer>() == 30);
+  REQUIRE(carr.begin()[2].as<Integer>() == 30);
+}
+
+TEST_CASE("object iterators", "[Node]")
+{
+  Node n{Pair{"c", 1}, Pair{"a", 2}, Pair{"b", 3}};
+  const Object & cobj(n.as<Object>());
+  std::vector<std::string> keys;
+  for(const Object::value_type & p : cobj)
+  {
+    keys.push_back(p.first);
+  }
+  REQUIRE(keys == std::vector<std::string>{"c", "a", "b"});
+  REQUIRE(std::distance(cobj.begin(), cobj.end()) == 3);
+  REQUIRE((--cobj.end())->first == "b");
+  // keys cannot be modified through the iterators
+  static_assert(std::is_const<std::remove_reference<decltype(*n.as<Object>().begin())>::type::first_type>::value,
+                "mutable object key");
+  for(Object::value_type & p : n.as<Object>())
+  {
+    p.second = p.second.as<Integer>() + 1;
+  }
+  REQUIRE(formatJson(n) == "{\"c\":2,\"a\":3,\"b\":4}");
+  Object::const_iterator itr = n.as<Object>().begin();
+  REQUIRE(itr == cobj.cbegin());
+
+  REQUIRE(cobj.keyView().size() == 3);
+  REQUIRE(std::vector<std::string>(cobj.keyView().begin(), cobj.keyView().end()) == keys);
+  Integer sum = 0;
+  for(const Node & v : cobj.valueView())
+  {
+    sum += v.as<Integer>();
+  }
+  REQUIRE(sum == 9);
+  for(Node & v : n.as<Object>().valueView())
+  {
+    v = Null();
+  }
+  REQUIRE(formatJson(n) == "{\"c\":null,\"a\":null,\"b\":null}");
+  REQUIRE(Object().keyView().empty());
+}
+
+TEST_CASE("array unchecked access", "[Node]")
+{
+  Node n = Array();
+  Array & arr(n.as<Array>());
+  arr.reserve(100);
+  REQUIRE(arr.capacity() >= 100);
+  REQUIRE(arr.empty());
+  for(Integer i = 0; i < 10; i++)
+  {
+    arr.pushBack(i);
+  }
+  REQUIRE(arr.unsafeAt(3).as<Integer>() == 3);
+  REQUIRE(arr.data()[9].as<Integer>() == 9);
+  REQUIRE_THROWS_AS(arr[10], std::out_of_range);
+  Integer sum = 0;
+  for(const Node & node : n.as<Array>().span())
+  {
+    sum += node.as<Integer>();
+  }
+  REQUIRE(sum == 45);
+  Array::Span s = arr.span().subspan(2, 3);
+  REQUIRE(s.size() == 3);
+  s[0] = "two";
+  REQUIRE(arr[2] == Node("two"));
+  Array::ConstSpan cs = s;
+  REQUIRE(cs.end() - cs.begin() == 3);
+  arr.shrinkToFit();
+  REQUIRE(arr.capacity() >= arr.size());
+  REQUIRE(formatJson(n) == "[0,1,\"two\",3,4,5,6,7,8,9]");
+  REQUIRE(n.find("12") == Undefined());
+  REQUIRE_THROWS_AS(n.update("12", Integer(1)), PathError);
+}
+
+TEST_CASE("deep equality", "[Node]")
+{
+  Node a{Pair{"x", Array{1, 2.0, "three"}}, Pair{"y", Object{{"z", Null()}}}};
+  Node b{Pair{"x", Array{1, 2.0, "three"}}, Pair{"y", Object{{"z", Null()}}}};
+  Node c{Pair{"y", Object{{"z", Null()}}}, Pair{"x", Array{1, 2.0, "three"}}};
+  REQUIRE(a == b);
+  REQUIRE(a != c);
+  REQUIRE(Node(Array{1, 2}) == Node(Array{1, 2}));
+  REQUIRE(Node(Array{1, 2}) != Node(Array{1, 2, 3}));
+  REQUIRE(Node(Array{1, 2}) != Node(Array{1, 2.0}));
+  REQUIRE(Node(Object{{"a", 1}}) != Node(Object{{"b", 1}}));
+  b.update("x/2", String("four"));
+  REQUIRE(a != b);
+  b.update("x/2", String("three"));
+  REQUIRE(a == b);
+}
+
+TEST_CASE("structural hash", "[Node]")
+{
+  Node a{Pair{"x", Array{1, 2.0, "three"}}, Pair{"y", Object{{"z", Null()}}}};
+  Node b{Pair{"x", Array{1, 2.0, "three"}}, Pair{"y", Object{{"z", Null()}}}};
+  REQUIRE(a.hash() == b.hash());
+  REQUIRE(Node(0.0).hash() == Node(-0.0).hash());
+  REQUIRE(Node(1).hash() != Node(2).hash());
+  REQUIRE(Node("a").hash() != Node("b").hash());
+
+  // cached hashes are invalidated by modifications
+  std::size_t h = a.hash();
+  a.as<Object>()["x"].as<Array>()[0] = 5;
+  REQUIRE(a.hash() != h);
+  REQUIRE(a != b);
+  a.as<Object>()["x"].as<Array>()[0] = 1;
+  REQUIRE(a.hash() == h);
+  REQUIRE(a == b);
+
+  std::unordered_set<Node> set;
+  set.insert(a);
+  set.insert(b);
+  set.insert(Node(Array{1, 2}));
+  REQUIRE(set.size() == 2);
+  REQUIRE(set.count(Node(Array{1, 2})) == 1);
+}
+
+TEST_CASE("dedupe", "[Node]")
+{
+  Node limits{Pair{"cpu", 4}, Pair{"mem", "2G"}};
+  Node doc = Array{Object{Pair{"name", "a"}, Pair{"limits", limits}},
+                   Object{Pair{"name", "b"}, Pair{"limits", limits}},
+                   Object{Pair{"name", "c"}, Pair{"limits", Object{Pair{"cpu", 4}}}}};
+  std::string json = formatJson(doc);
+  Node copy = doc;
+  doc.dedupe();
+  const Node & shared(doc);
+  REQUIRE(formatJson(doc) == json);
+  REQUIRE(doc == copy);
+  REQUIRE(shared.as<Array>()[0].as<Object>()["limits"].isShared());
+  REQUIRE(&shared.as<Array>()[0].as<Object>()["limits"].as<Object>() ==
+          &shared.as<Array>()[1].as<Object>()["limits"].as<Object>());
+  REQUIRE(copy.as<Array>()[0].as<Object>()["limits"].isShared() == false);
+
+  // copy on write
+  REQUIRE(doc.update("1/limits/cpu", Integer(8)));
+  REQUIRE(shared.find("0/limits/cpu") == Integer(4));
+  REQUIRE(shared.find("1/limits/cpu") == Integer(8));
+  REQUIRE(shared.find("2/limits/cpu") == Integer(4));
+  REQUIRE(shared.as<Array>()[0].as<Object>()["limits"].isShared());
+  REQUIRE(shared.as<Array>()[1].as<Object>()["limits"].isShared() == false);
+
+  // copies of shared payloads are shared
+  Node limits2 = shared.find("0/limits");
+  REQUIRE(&static_cast<const Node&>(limits2).as<Object>() ==
+          &shared.as<Array>()[0].as<Object>()["limits"].as<Object>());
+  limits2.as<Object>().set("cpu", 1);
+  REQUIRE(shared.find("0/limits/cpu") == Integer(4));
+}
+
+TEST_CASE("payload pools", "[Node]")
+{
+  // outside of a scope the global allocator is used
+  PoolStatistics unpooled = poolStatistics<String>();
+  {
+    Node a("a string");
+    Node b = Array{"x", "y"};
+  }
+  REQUIRE(poolStatistics<String>().allocations == unpooled.allocations);
+  REQUIRE(poolStatistics<String>().deallocations == unpooled.deallocations);
+
+  PayloadPoolScope pooled;
+  PoolStatistics before = poolStatistics<String>();
+  PoolStatistics during;
+  {
+    Node a("a string");
+    Node b = Array{"x", "y"};
+    during = poolStatistics<String>();
+    REQUIRE(during.allocations >= before.allocations + 3);
+    REQUIRE(during.slabs > 0);
+    REQUIRE(during.bytesReserved >= during.slabs * during.blockSize);
+    REQUIRE(poolStatistics<Array>().allocations > 0);
+  }
+  // everything allocated in the scope went back to the pool
+  PoolStatistics after = poolStatistics<String>();
+  REQUIRE(after.deallocations - before.deallocations == during.allocations - before.allocations);
+  REQUIRE(after.cached >= 3);
+
+  // freed blocks are reused before new slabs are allocated
+  Node c("recycled");
+  REQUIRE(poolStatistics<String>().slabs == after.slabs);
+
+  // nodes created on another thread are released here
+  Node fromThread;
+  std::thread t([&fromThread](){
+      PayloadPoolScope threadPooled;
+      fromThread = Array{"p", "q", "r"};
+    });
+  t.join();
+  REQUIRE(poolStatistics<String>().orphaned + poolStatistics<String>().cached > 0);
+  PoolStatistics beforeRelease = poolStatistics<String>();
+  fromThread = Node();
+  REQUIRE(poolStatistics<String>().deallocations == beforeRelease.deallocations + 3);
+
+  // released after the thread's cache was handed back
+  std::thread late([](){
+    static thread_local Node keep;
+    PayloadPoolScope threadPooled;
+    keep = Node("late");
+  });
+  late.join();
+  REQUIRE(poolStatistics<String>().orphaned > 0);
+
+  // a thread adopts a bounded number of orphaned blocks at a time
+  std::thread many([](){
+      PayloadPoolScope threadPooled;
+      std::vector<Node> strings(2000, Node(""));
+      for(Node & s : strings)
+      {
+        s = Node("orphan");
+      }
+      static thread_local std::vector<Node> keep;
+      keep.swap(strings);
+    });
+  many.join();
+  std::size_t orphaned = poolStatistics<String>().orphaned;
+  REQUIRE(orphaned >= 2000);
+  std::thread adopt([orphaned](){
+      PayloadPoolScope threadPooled;
+      Node one("adopted");
+      REQUIRE(poolStatistics<String>().cached < 1000);
+      REQUIRE(poolStatistics<String>().orphaned + 1000 > orphaned);
+    });
+  adopt.join();
+}
+
+TEST_CASE("compact", "[Node]")
+{
+  Node node = Object{Pair{"list", Array{}}, Pair{"text", "short"}};
+  Array & arr(node.as<Object>()["list"].as<Array>());
+  for(int i = 0; i < 33; i++)
+  {
+    arr.pushBack(i);
+  }
+  String & text(node.as<Object>()["text"].as<String>());
+  text.reserve(1000);
+  Node shared = Array{1, 2, 3};
+  shared.as<Array>().reserve(100);
+  shared.dedupe();
+  node.as<Object>().set("shared", shared);
+  Node copy = node;
+  REQUIRE(arr.capacity() > arr.size());
+  node.compact();
+  REQUIRE(node == copy);
+  REQUIRE(node.as<Object>()["list"].as<Array>().capacity() == 33u);
+  REQUIRE(node.as<Object>()["text"].as<String>().capacity() < 1000u);
+  const Node & sharedRef(node.as<Object>()["shared"]);
+  REQUIRE(sharedRef.isShared());
+  REQUIRE(sharedRef.as<Array>().capacity() == 100u);
+}
+
+TEST_CASE("object key index", "[Node]")
+{
+  Object obj{Pair{"a", 1}, Pair{"b", 2}, Pair{"c", 3}};
+  std::size_t h = Object::hashKey("b");
+  REQUIRE(obj.has("b", h));
+  REQUIRE(obj.get("b", h) == Integer(2));
+  REQUIRE_FALSE(obj.set("b", h, Node(20)));
+  REQUIRE(obj.set("d", Object::hashKey("d"), Node(4)));
+  REQUIRE(obj["b"] == Integer(20));
+  REQUIRE(obj.remove([](const String & key, const Node & node){ return key == "a" || key == "c"; }) == 2u);
+  REQUIRE_FALSE(obj.has("a"));
+  REQUIRE_FALSE(obj.has("c"));
+  REQUIRE(obj.keys() == Node(Array{"b", "d"}));
+  REQUIRE(obj.set("a", 1));
+  REQUIRE(obj.keys() == Node(Array{"b", "d", "a"}));
+  Object copy(obj);
+  REQUIRE(copy.has("a"));
+  REQUIRE(copy.remove("a"));
+  REQUIRE_FALSE(copy.has("a"));
+  REQUIRE(obj.has("a"));
+}
+
+TEST_CASE("string pool", "[Node]")
+{
+  StringPool pool(8, 2);
+  const Node a = pool.intern("short");
+  const Node b = pool.intern("short");
+  REQUIRE(a == Node("short"));
+  REQUIRE(a.isShared());
+  REQUIRE(&a.as<String>() == &b.as<String>());
+  REQUIRE(pool.size() == 1u);
+  REQUIRE_FALSE(pool.intern("longer than eight").isShared());
+  REQUIRE(pool.intern("second").isShared());
+  // the pool is full
+  REQUIRE_FALSE(pool.intern("third").isShared());
+  REQUIRE(pool.size() == 2u);
+
+  // copy on write leaves the pool untouched
+  Node c = pool.intern("short");
+  c.as<String>() += "er";
+  REQUIRE(c == Node("shorter"));
+  REQUIRE(pool.intern("short") == Node("short"));
+}
+
+TEST_CASE("interned object keys", "[Node]")
+{
+  StringPool pool(8, 2);
+  const Key a = pool.key("name");
+  const Key b = pool.key("name");
+  REQUIRE(&a.str() == &b.str());
+  REQUIRE(a.hash() == Object::hashKey("name"));
+  REQUIRE(pool.keyCount() == 1u);
+  REQUIRE(pool.size() == 0u);
+  // long keys and keys past the limit carry their hash too
+  const Key c = pool.key("longer than eight");
+  REQUIRE(c.str() == "longer than eight");
+  REQUIRE(c.hash() == Object::hashKey("longer than eight"));
+  pool.key("id");
+  REQUIRE(pool.key("third").hash() == Object::hashKey("third"));
+  REQUIRE(pool.keyCount() == 2u);
+  REQUIRE(Key(String("name")) == a);
+  REQUIRE(Key(String("id")) != a);
+
+  Object obj;
+  REQUIRE(obj.set(a, Node(1)));
+  REQUIRE_FALSE(obj.set(b, Node(2)));
+  REQUIRE(obj.set(c, Node(3)));
+  REQUIRE(obj.has(a));
+  REQUIRE(obj.get(a) == Node(2));
+  REQUIRE(obj.get("name") == Node(2));
+  REQUIRE(obj.get(Key(String("longer than eight"))) == Node(3));
+  REQUIRE_FALSE(obj.has(pool.key("id")));
+  REQUIRE(obj == Object({{"name", 2}, {"longer than eight", 3}}));
+  REQUIRE(obj.hash() == Object({{"name", 2}, {"longer than eight", 3}}).hash());
+  REQUIRE(obj.remove("name"));
+  REQUIRE_FALSE(obj.has(b));
+  REQUIRE(obj.size() == 1u);
+}
+
+static Node deepArray(std::size_t depth)
+{
+  Node node;
+  for(std::size_t i = 0; i < depth; i++)
+  {
+    Array arr;
+    arr.pushBack(std::move(node));
+    arr.pushBack(Object{Pair{"i", Integer(i)}});
+    node = Node(Node::Value(std::move(arr)));
+  }
+  return node;
+}
+
+TEST_CASE("destroy deep tree", "[Node]")
+{
+  Node node = deepArray(1000000);
+  REQUIRE(node.as<Array>().size() == 2u);
+  node = Node();
+  REQUIRE(node.isA<Null>());
+}
+
+TEST_CASE("background reclaimer", "[Node]")
+{
+  Reclaimer reclaimer;
+  Node node = deepArray(1000);
+  Node shared = node.as<Array>()[1];
+  reclaimer.reclaim(std::move(node));
+  REQUIRE(node.isA<Null>());
+  reclaimer.reclaim(deepArray(10));
+  reclaimer.flush();
+  REQUIRE(reclaimer.reclaimed() == 2u);
+  REQUIRE(shared.find("i") == Integer(999));
+
+  Reclaimer::global().flush();
+  std::size_t before = Reclaimer::global().reclaimed();
+  deferredDestroy(deepArray(10));
+  Reclaimer::global().flush();
+  REQUIRE(Reclaimer::global().reclaimed() - before == 1u);
+}
+
 TEST_CASE("update operations", "[Node]")
 {
   {
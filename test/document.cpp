@@ -0,0 +1,127 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <catch2/catch.hpp>
+#include <surfsara/ast.h>
+#include <surfsara/json_parser.h>
+#include <surfsara/json_format.h>
+#include <surfsara/document.h>
+
+using namespace surfsara::ast;
+
+TEST_CASE("parse document", "[Document]")
+{
+  std::string json = "{\"a\":[null,1,true,1.5,\"a long string value that does not fit in place\"],"
+                     "\"a long key that does not fit in place\":{\"c\":\"d\"},\"e\":[]}";
+  Document doc = parseDocument(json);
+  REQUIRE(doc.root().isA<Object>());
+  REQUIRE(doc.root() == parseJson(json));
+  REQUIRE(formatJson(doc.root()) == json);
+  REQUIRE(doc.root().as<Object>()["a"].as<Array>().size() == 5u);
+  REQUIRE(doc.bytesAllocated() > 0u);
+}
+
+TEST_CASE("copy node out of document", "[Document]")
+{
+  Node copy;
+  {
+    Document doc = parseDocument("{\"a\":{\"b\":[1,2,3]}}");
+    copy = doc.root().as<Object>()["a"];
+    REQUIRE(copy == doc.root().as<Object>()["a"]);
+  }
+  // the copy outlives the arena
+  copy.as<Object>()["b"].as<Array>().pushBack(4);
+  REQUIRE(formatJson(copy) == "{\"b\":[1,2,3,4]}");
+}
+
+TEST_CASE("move and reparse document", "[Document]")
+{
+  Document doc = parseDocument("[1,2]");
+  Document other(std::move(doc));
+  REQUIRE(doc.root().isA<Null>());
+  REQUIRE(formatJson(other.root()) == "[1,2]");
+  doc = std::move(other);
+  REQUIRE(formatJson(doc.root()) == "[1,2]");
+  doc.parse("{\"x\":\"y\"}");
+  REQUIRE(formatJson(doc.root()) == "{\"x\":\"y\"}");
+  REQUIRE_THROWS(doc.parse("[1,"));
+  REQUIRE(formatJson(doc.root()) == "{\"x\":\"y\"}");
+}
+
+TEST_CASE("parse document with options", "[Document]")
+{
+  ParseOptions options;
+  options.dedupe = true;
+  options.hash = true;
+  Document doc = parseDocument("[{\"a\":[1,2]},{\"a\":[1,2]}]", options);
+  const Array & arr(doc.root().as<Array>());
+  REQUIRE(&arr.unsafeAt(0).as<Object>() == &arr.unsafeAt(1).as<Object>());
+  Node copy(doc.root());
+  REQUIRE(copy == doc.root());
+  REQUIRE(copy.hash() == doc.root().hash());
+}
+
+TEST_CASE("parse document with borrowed strings", "[Document]")
+{
+  std::string json = "{\"a\":\"borrowed from the input buffer\",\"b\":[\"c\\td\"]}";
+  ParseOptions options;
+  options.borrow = true;
+  Document doc = parseDocument(json, options);
+  REQUIRE(doc.root().as<Object>()["a"].isLazy());
+  REQUIRE(doc.root() == parseJson(json));
+  REQUIRE(formatJson(doc.root()) == json);
+}
+
+TEST_CASE("arena only destroys nodes that own heap memory", "[Document]")
+{
+  std::string small("[");
+  for(int i = 0; i < 1000; i++)
+  {
+    small += (i ? "," : "") + std::string("{\"id\":") + std::to_string(i) + ",\"name\":\"short\",\"tags\":[1,2.5]}";
+  }
+  small += "]";
+  std::string large = "{\"a\":[\"a long string value that does not fit in place\",1],"
+                      "\"a long key that does not fit in place\":{\"c\":\"d\"},\"e\":{\"x\":[1,2]}}";
+  std::vector<std::size_t> cleanups;
+  for(const std::string & json : {small, large})
+  {
+    for(bool defer : {false, true})
+    {
+      ParseOptions options;
+      if(defer)
+      {
+        options.deferKeys.insert("e");
+      }
+      details::Arena arena;
+      detail::Parser p(options, arena);
+      p.parse(json);
+      const Node root(p.takeValue());
+      cleanups.push_back(arena.cleanupCount());
+      REQUIRE(root == parseJson(json));
+      // expanding a deferred subtree keeps the registration of the text
+      REQUIRE(arena.cleanupCount() == cleanups.back());
+    }
+  }
+  // the long string and the object with the long key, plus the deferred text
+  REQUIRE(cleanups == std::vector<std::size_t>({0, 0, 2, 3}));
+}
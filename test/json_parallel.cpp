@@ -0,0 +1,205 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <catch2/catch.hpp>
+#include <surfsara/ast.h>
+#include <surfsara/json_parser.h>
+#include <surfsara/json_format.h>
+#include <surfsara/json_parallel.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+using namespace surfsara::ast;
+
+namespace
+{
+  std::string largeArray(std::size_t n)
+  {
+    std::string json("[\n");
+    for(std::size_t i = 0; i < n; i++)
+    {
+      json += (i ? ",\n" : "");
+      json += "{\"id\":" + std::to_string(i) + ",\"s\":\"a,]\\\\\\\"[{\",\"v\":[1,{\"x\":\"}\"}]}";
+    }
+    json += "\n]\n";
+    return json;
+  }
+
+  /**
+   * private directory, removed with the files in it
+   */
+  class TempDir
+  {
+  public:
+    TempDir()
+    {
+      const char * tmp = std::getenv("TMPDIR");
+      std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/json_parallel_XXXXXX";
+      std::vector<char> buffer(pattern.begin(), pattern.end());
+      buffer.push_back('\0');
+      if(mkdtemp(buffer.data()) == nullptr)
+      {
+        throw std::runtime_error("cannot create temporary directory");
+      }
+      dir = buffer.data();
+    }
+
+    ~TempDir()
+    {
+      for(const std::string & file : files)
+      {
+        std::remove(file.c_str());
+      }
+      std::remove(dir.c_str());
+    }
+
+    std::string file(const std::string & name)
+    {
+      files.push_back(dir + "/" + name);
+      return files.back();
+    }
+
+  private:
+    std::string dir;
+    std::vector<std::string> files;
+  };
+}
+
+TEST_CASE("parallel parse of an array", "[JsonParallel]")
+{
+  std::string json = largeArray(5000);
+  Node expected = parseJson(json);
+  REQUIRE(parseJsonParallel(json, 4) == expected);
+  REQUIRE(parseJsonParallel(json, 7) == expected);
+  REQUIRE(parseJsonParallel(json, 1) == expected);
+  REQUIRE(parseJsonParallel(json) == expected);
+}
+
+TEST_CASE("parallel parse of an object", "[JsonParallel]")
+{
+  std::string json("{");
+  for(std::size_t i = 0; i < 5000; i++)
+  {
+    json += (i ? ", " : "");
+    json += "\"key," + std::to_string(i) + "\" : [\"\\\\\", " + std::to_string(i) + "]";
+  }
+  json += "}";
+  Node expected = parseJson(json);
+  Node node = parseJsonParallel(json, 5);
+  REQUIRE(node == expected);
+  REQUIRE(formatJson(node) == formatJson(expected));
+}
+
+TEST_CASE("parallel parse of one large element", "[JsonParallel]")
+{
+  // no cuts inside the element
+  std::string json = "[" + largeArray(2000) + ",1]";
+  REQUIRE(parseJsonParallel(json, 4) == parseJson(json));
+  REQUIRE(parseJsonParallel("[1]", 4) == parseJson("[1]"));
+  REQUIRE(parseJsonParallel("\"x\"", 4) == Node("x"));
+}
+
+TEST_CASE("parallel parse errors", "[JsonParallel]")
+{
+  std::string json = largeArray(2000);
+  std::string trailing(json);
+  trailing.insert(trailing.rfind(']'), ",");
+  REQUIRE_THROWS(parseJsonParallel(trailing, 4));
+  std::string unterminated(json);
+  unterminated.insert(json.size() / 2, "\"");
+  REQUIRE_THROWS(parseJsonParallel(unterminated, 4));
+  std::string broken(json);
+  broken.insert(json.find(",\n", json.size() / 3) + 2, "#");
+  REQUIRE_THROWS(parseJsonParallel(broken, 4));
+}
+
+TEST_CASE("batch parse", "[JsonParallel]")
+{
+  std::vector<std::string> docs;
+  for(std::size_t i = 0; i < 1000; i++)
+  {
+    docs.push_back("{\"id\":" + std::to_string(i) + ",\"v\":[" + std::string(i % 7, '1') + "]}");
+  }
+  std::vector<Node> nodes = parseJsonBatch(docs, 4);
+  REQUIRE(nodes.size() == docs.size());
+  std::size_t mismatch = 0;
+  for(std::size_t i = 0; i < docs.size(); i++)
+  {
+    mismatch += (nodes[i] == parseJson(docs[i]) ? 0 : 1);
+  }
+  REQUIRE(mismatch == 0);
+  REQUIRE(parseJsonBatch(std::vector<std::string>()).empty());
+
+  ParserPool pool(3);
+  REQUIRE(pool.size() == 3);
+  REQUIRE(pool.parse(docs) == nodes);
+  docs[500] = "[1,";
+  REQUIRE_THROWS(pool.parse(docs));
+  docs[500] = "[1]";
+  REQUIRE(pool.parse(docs)[500] == parseJson(std::string("[1]")));
+
+  // batches from several threads take turns
+  std::vector<std::vector<Node>> concurrent(4);
+  std::vector<std::thread> callers;
+  for(std::size_t t = 0; t < concurrent.size(); t++)
+  {
+    callers.push_back(std::thread([&, t](){ concurrent[t] = pool.parse(docs, ParseOptions(), t); }));
+  }
+  for(std::thread & t : callers)
+  {
+    t.join();
+  }
+  for(const std::vector<Node> & result : concurrent)
+  {
+    REQUIRE(result == pool.parse(docs));
+  }
+
+  // the free functions share one pool, options apply per batch
+  REQUIRE(&ParserPool::shared() == &ParserPool::shared());
+  ParseOptions lazy;
+  lazy.lazyNumbers = true;
+  REQUIRE(parseJsonBatch(docs, 2, lazy)[3].as<Object>()["id"].isLazy());
+  REQUIRE_FALSE(parseJsonBatch(docs, 2)[3].as<Object>()["id"].isLazy());
+}
+
+TEST_CASE("batch parse of files", "[JsonParallel]")
+{
+  TempDir tmp;
+  std::vector<std::string> files;
+  for(std::size_t i = 0; i < 20; i++)
+  {
+    files.push_back(tmp.file(std::to_string(i) + ".json"));
+    std::ofstream ost(files.back());
+    ost << "{\"file\":" << i << ",\"s\":\"" << std::string(i * 100, 'x') << "\"}";
+  }
+  ParseOptions options;
+  options.borrow = true;
+  std::vector<Node> nodes = parseJsonFiles(files, 4, options);
+  REQUIRE(nodes.size() == files.size());
+  REQUIRE(nodes[7].as<Object>()["file"].as<Integer>() == 7);
+  REQUIRE(nodes[19].as<Object>()["s"].as<String>() == std::string(1900, 'x'));
+  files.push_back(tmp.file("missing.json"));
+  REQUIRE_THROWS(parseJsonFiles(files, 2));
+}
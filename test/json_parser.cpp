@@ -25,6 +25,8 @@ SOFTWARE.
 #include <surfsara/ast.h>
 #include <surfsara/json_parser.h>
 #include <surfsara/json_format.h>
+#include <surfsara/document.h>
+#include <thread>
 
 using namespace surfsara::ast;
 
@@ -111,3 +113,643 @@ TEST_CASE("parse object", "[JsonParser]")
   REQUIRE(parseJson(json).isA<Object>());
   REQUIRE(formatJson(parseJson(json)) == result);
 }
+
+TEST_CASE("parse with hashes", "[JsonParser]")
+{
+  std::string json = "{\"a\":[1,2,{\"b\":\"c\"}],\"d\":{\"e\":[]}}";
+  ParseOptions options;
+  options.hash = true;
+  Node hashed = parseJson(json, options);
+  Node plain = parseJson(json);
+  REQUIRE(hashed == plain);
+  REQUIRE(hashed.hash() == plain.hash());
+  REQUIRE(hashed != parseJson("{\"a\":[1,2,{\"b\":\"x\"}],\"d\":{\"e\":[]}}", options));
+  REQUIRE(formatJson(hashed) == json);
+}
+
+TEST_CASE("hashes do not go stale through references", "[JsonParser]")
+{
+  ParseOptions options;
+  for(bool cached : {false, true})
+  {
+    options.hash = cached;
+    Node a = parseJson("{\"x\":{\"y\":[1,2]}}", options);
+    Node b = parseJson("{\"x\":{\"y\":[1,3]}}", options);
+    Node & e = b.as<Object>()["x"].as<Object>()["y"].as<Array>()[1];
+    REQUIRE(a.hash() != b.hash());
+    e = 2;
+    REQUIRE(a == b);
+    REQUIRE(a.hash() == b.hash());
+  }
+}
+
+TEST_CASE("parse with dedupe", "[JsonParser]")
+{
+  std::string json = "[{\"a\":[1,\"x\"]},{\"a\":[1,\"x\"]},{\"a\":[2,\"x\"]}]";
+  ParseOptions options;
+  options.dedupe = true;
+  const Node node = parseJson(json, options);
+  REQUIRE(formatJson(node) == json);
+  REQUIRE(node == parseJson(json));
+  REQUIRE(&node.as<Array>()[0].as<Object>() == &node.as<Array>()[1].as<Object>());
+  REQUIRE(&node.as<Array>()[0].as<Object>() != &node.as<Array>()[2].as<Object>());
+  REQUIRE(&node.as<Array>()[0].as<Object>()["a"].as<Array>()[1].as<String>() ==
+          &node.as<Array>()[2].as<Object>()["a"].as<Array>()[1].as<String>());
+  REQUIRE(node.as<Array>()[2].as<Object>()["a"].as<Array>()[1].isShared());
+}
+
+TEST_CASE("parse with compact", "[JsonParser]")
+{
+  std::string json = "{\"a\":[1,2,3,4,5],\"b\":\"a string longer than the small buffer\"}";
+  ParseOptions options;
+  options.compact = true;
+  const Node node = parseJson(json, options);
+  REQUIRE(formatJson(node) == json);
+  REQUIRE(node.as<Object>()["a"].as<Array>().capacity() == 5u);
+  const String & b(node.as<Object>()["b"].as<String>());
+  REQUIRE(b.capacity() == b.size());
+}
+
+TEST_CASE("parse with string pool", "[JsonParser]")
+{
+  std::string json = "[{\"s\":\"on\",\"t\":\"a string longer than the pool limit\"},{\"s\":\"on\"},\"on\"]";
+  StringPool pool(16);
+  ParseOptions options;
+  options.strings = &pool;
+  const Node node = parseJson(json, options);
+  REQUIRE(formatJson(node) == json);
+  REQUIRE(node == parseJson(json));
+  const Node & first(node.as<Array>()[0].as<Object>()["s"]);
+  REQUIRE(first.isShared());
+  REQUIRE(&first.as<String>() == &node.as<Array>()[1].as<Object>()["s"].as<String>());
+  REQUIRE(&first.as<String>() == &node.as<Array>()[2].as<String>());
+  REQUIRE_FALSE(node.as<Array>()[0].as<Object>()["t"].isShared());
+  REQUIRE(pool.size() == 1u);
+  // both keys are interned, "s" once for the two objects
+  REQUIRE(pool.keyCount() == 2u);
+}
+
+TEST_CASE("parse keys into a shared pool", "[JsonParser]")
+{
+  StringPool pool(16);
+  ParseOptions options;
+  options.strings = &pool;
+  Parser parser(options);
+  std::vector<std::string> docs = {"{\"a\":1,\"b\":{\"c\":2}}",
+                                   "{\"a\":3,\"d\":4,\"b\":{\"c\":5}}",
+                                   "{\"a\":[{\"a\":6}],\"a very long key name\":7}"};
+  Node node;
+  for(const std::string & doc : docs)
+  {
+    node = parser.parse(doc);
+    REQUIRE(node == parseJson(doc));
+  }
+  REQUIRE(pool.keyCount() == 4u);
+  REQUIRE(node.as<Object>().has(pool.key("a")));
+  REQUIRE(node.as<Object>()["a"].as<Array>()[0].as<Object>().get(pool.key("a")) == Node(6));
+  REQUIRE(node.as<Object>().get(pool.key("a very long key name")) == Node(7));
+}
+
+TEST_CASE("parse with borrowed strings", "[JsonParser]")
+{
+  std::string json = "{\"plain\":\"a string longer than the small buffer\",\"esc\":\"a\\nb\",\"arr\":[\"x\",\"\"]}";
+  ParseOptions options;
+  options.borrow = true;
+  Node copy;
+  {
+    const Node node = parseJson(json, options);
+    const Object & obj(node.as<Object>());
+    REQUIRE(obj["plain"].isLazy());
+    REQUIRE(obj["plain"].isA<String>());
+    REQUIRE_FALSE(obj["esc"].isLazy());
+    REQUIRE(obj["esc"].as<String>() == "a\nb");
+    REQUIRE(obj["arr"].as<Array>()[1].isLazy());
+    REQUIRE(obj["arr"].as<Array>()[1].as<String>() == "");
+    REQUIRE(node == parseJson(json));
+    REQUIRE(node.hash() == parseJson(json).hash());
+    REQUIRE(formatJson(node) == json);
+    REQUIRE(obj["plain"].as<String>() == "a string longer than the small buffer");
+    copy = node;
+  }
+  // copies do not reference the input
+  json.assign(json.size(), ' ');
+  REQUIRE_FALSE(copy.as<Object>()["plain"].isLazy());
+  REQUIRE(copy.find("plain") == Node("a string longer than the small buffer"));
+
+  // becomes an ordinary string when modified
+  std::string abc = "\"abc\"";
+  Node node = parseJson(abc, options);
+  REQUIRE(node.isLazy());
+  node.as<String>() += "d";
+  REQUIRE_FALSE(node.isLazy());
+  REQUIRE(node == Node("abcd"));
+
+  // read from the input until as<String>() const copies it
+  std::string xyz = "[\"xyz\"]";
+  const Node arr = parseJson(xyz, options);
+  const char * data = nullptr;
+  std::size_t size = 0;
+  REQUIRE(arr.as<Array>()[0].stringData(data, size));
+  REQUIRE(data == xyz.data() + 2);
+  REQUIRE(size == 3u);
+  REQUIRE(formatJson(arr) == xyz);
+  REQUIRE(arr == parseJson(xyz));
+  REQUIRE(arr.hash() == parseJson(xyz).hash());
+  xyz[2] = 'X';
+  REQUIRE(arr.as<Array>()[0].as<String>() == "Xyz");
+  xyz[2] = 'x';
+  REQUIRE(arr.as<Array>()[0].as<String>() == "Xyz");
+  REQUIRE_FALSE(Node(1).stringData(data, size));
+}
+
+TEST_CASE("borrowed strings across chunks", "[JsonParser]")
+{
+  std::string json = "[\"first\",\"split string\",\"last\"]";
+  ParseOptions options;
+  options.borrow = true;
+  detail::Parser p(options);
+  p.parseChunk(json.c_str(), 15);
+  p.parseChunk(json.c_str() + 15, json.size() - 15);
+  p.flush();
+  Node node(p.takeValue());
+  REQUIRE(node.as<Array>()[0].isLazy());
+  REQUIRE_FALSE(node.as<Array>()[1].isLazy());
+  REQUIRE(node.as<Array>()[2].isLazy());
+  REQUIRE(formatJson(node) == json);
+}
+
+TEST_CASE("parse with lazy numbers", "[JsonParser]")
+{
+  std::string json = "{\"i\":12,\"f\":1.10,\"e\":1E+2,\"a\":[-0,2.50]}";
+  ParseOptions options;
+  options.lazyNumbers = true;
+  const Node node = parseJson(json, options);
+  const Object & obj(node.as<Object>());
+  REQUIRE(formatJson(node) == json);
+  REQUIRE(obj["i"].isLazy());
+  REQUIRE(obj["i"].isA<Integer>());
+  REQUIRE_FALSE(obj["i"].isA<Float>());
+  REQUIRE(obj["i"].as<Integer>() == 12);
+  REQUIRE(obj["f"].isA<Float>());
+  REQUIRE(obj["f"].as<Float>() == 1.1);
+  REQUIRE(*obj["f"].numberText() == "1.10");
+  REQUIRE(obj["e"].as<Float>() == 100.0);
+  REQUIRE(node == parseJson(json));
+  REQUIRE(node.hash() == parseJson(json).hash());
+  REQUIRE(parseJson("1", options) == Node(Integer(1)));
+  REQUIRE(parseJson("1", options) != Node(Float(1.0)));
+
+  // copies keep the text
+  Node copy(node);
+  REQUIRE(copy.as<Object>()["f"].isLazy());
+  REQUIRE(formatJson(copy) == json);
+
+  // becomes an ordinary number when modified
+  Node f = parseJson("2.50", options);
+  f.as<Float>() += 1.0;
+  REQUIRE_FALSE(f.isLazy());
+  REQUIRE(f.numberText() == nullptr);
+  REQUIRE(f == Node(Float(3.5)));
+
+  // range errors are reported on access
+  Node big = parseJson("[99999999999999999999]", options);
+  REQUIRE_THROWS_AS(big.as<Array>()[0].as<Integer>(), std::out_of_range);
+  REQUIRE_THROWS(parseJson("[99999999999999999999]"));
+  // twice, the failed conversion is remembered
+  REQUIRE_THROWS_AS(big.as<Array>()[0].as<Integer>(), std::out_of_range);
+
+  // such numbers only equal the same literal and do not throw
+  REQUIRE_NOTHROW(big == parseJson("[1]"));
+  REQUIRE(big != parseJson("[1]"));
+  REQUIRE(big != parseJson("[99999999999999999999.0]", options));
+  REQUIRE(big == parseJson("[99999999999999999999]", options));
+  REQUIRE(big.hash() == parseJson("[99999999999999999999]", options).hash());
+  REQUIRE(parseJson("[1e999]", options) != parseJson("[1]", options));
+  Node both = parseJson("[99999999999999999999,99999999999999999999]", options);
+  REQUIRE_NOTHROW(both.dedupe());
+}
+
+TEST_CASE("parse with deferred subtrees", "[JsonParser]")
+{
+  std::string json = "{\"id\":1,\"a\":{\"b\":[1,{\"c\":\"]}\\\"\"}],\"d\":{}},\"e\":[[2],3]}";
+  ParseOptions options;
+  options.deferDepth = 1;
+  const Node node = parseJson(json, options);
+  const Object & obj(node.as<Object>());
+  REQUIRE_FALSE(obj["id"].isLazy());
+  REQUIRE(obj["a"].isLazy());
+  REQUIRE(obj["a"].isA<Object>());
+  REQUIRE_FALSE(obj["a"].isA<Array>());
+  REQUIRE(obj["e"].isA<Array>());
+  REQUIRE(node.find("a/b/1/c") == Node("]}\""));
+  // expanded one level at a time
+  REQUIRE(obj["a"].as<Object>()["b"].isLazy());
+  REQUIRE(node == parseJson(json));
+  REQUIRE(node.hash() == parseJson(json).hash());
+  REQUIRE(formatJson(node) == json);
+
+  // compact output is written from the text without parsing it
+  std::string spaced = "{\"a\": { \"b\" : [1, \"x\\qy\\n\"] },\n \"c\": [ ] }";
+  const Node unparsed = parseJson(spaced, options);
+  // allocations are counted by the pool
+  PayloadPoolScope pooled;
+  std::size_t before = poolStatistics<Object>().allocations;
+  REQUIRE(formatJson(unparsed) == "{\"a\":{\"b\":[1,\"xy\\n\"]},\"c\":[]}");
+  REQUIRE(poolStatistics<Object>().allocations == before);
+  REQUIRE(formatJson(unparsed) == formatJson(parseJson(spaced)));
+  REQUIRE(formatJson(unparsed, true) == formatJson(parseJson(spaced), true));
+
+  // becomes an ordinary object when modified
+  Node copy(node);
+  copy.as<Object>()["a"].as<Object>().set("x", Node(Integer(2)));
+  REQUIRE_FALSE(copy.as<Object>()["a"].isLazy());
+  REQUIRE(copy.find("a/x") == Node(Integer(2)));
+  REQUIRE(copy.find("a/d").isA<Object>());
+
+  // the skipped text is checked while parsing
+  REQUIRE_THROWS(parseJson("[[1,}]", options));
+  REQUIRE_THROWS(parseJson("[[1 2]]", options));
+  std::string::const_iterator begin = json.begin();
+  REQUIRE(formatJson(parseJson(begin, json.cend(), options)) == json);
+  std::string bad("[{\"a\":[1,]}]");
+  begin = bad.begin();
+  REQUIRE_THROWS(parseJson(begin, bad.cend(), options));
+}
+
+TEST_CASE("parse with deferred keys", "[JsonParser]")
+{
+  std::string json = "[{\"skip\":{\"x\":1},\"keep\":{\"x\":2}},{\"skip\":[]}]";
+  ParseOptions options;
+  options.deferKeys.insert("skip");
+  Document doc;
+  doc.parse(json, options);
+  const Node & node(doc.root());
+  REQUIRE(node.as<Array>()[0].as<Object>()["skip"].isLazy());
+  REQUIRE_FALSE(node.as<Array>()[0].as<Object>()["keep"].isLazy());
+  REQUIRE(node.as<Array>()[1].as<Object>()["skip"].isA<Array>());
+  REQUIRE(node.find("0/skip/x") == Node(Integer(1)));
+  REQUIRE(formatJson(node) == json);
+
+  // expanded into the arena of the document, also by concurrent readers
+  std::string many("[");
+  for(int i = 0; i < 64; i++)
+  {
+    many += (i ? "," : "") + std::string("{\"skip\":{\"x\":") + std::to_string(i) + "}}";
+  }
+  many += "]";
+  Document shared;
+  shared.parse(many, options);
+  PayloadPoolScope pooled;
+  std::size_t before = poolStatistics<Object>().allocations;
+  REQUIRE(shared.root().find("63/skip/x") == Node(Integer(63)));
+  REQUIRE(poolStatistics<Object>().allocations == before);
+  std::vector<std::thread> readers;
+  std::vector<int> found(4, 0);
+  for(int t = 0; t < 4; t++)
+  {
+    readers.emplace_back([&shared, &found, t]() {
+        for(int i = 0; i < 64; i++)
+        {
+          found[t] += (shared.root().find(std::to_string(i) + "/skip/x") == Node(Integer(i)));
+        }
+      });
+  }
+  for(std::thread & reader : readers)
+  {
+    reader.join();
+  }
+  REQUIRE(found == std::vector<int>(4, 64));
+
+  // deferred text may span chunks
+  detail::Parser p(options);
+  p.parseChunk(json.c_str(), 14);
+  p.parseChunk(json.c_str() + 14, json.size() - 14);
+  p.flush();
+  REQUIRE(Node(p.takeValue()) == parseJson(json));
+}
+
+TEST_CASE("parse with paths", "[JsonParser]")
+{
+  std::string json =
+    "[{\"name\":\"a\",\"foods\":{\"likes\":[\"x\",{\"y\":1}],\"dislikes\":[\"z\"]}},"
+    "{\"name\":\"b\",\"foods\":{\"dislikes\":[]}},"
+    "{\"name\":\"c\",\"foods\":\"none\"}]";
+  const Node node = parseJson(json, {"*/foods/likes"});
+  REQUIRE(formatJson(node) == "[{\"foods\":{\"likes\":[\"x\",{\"y\":1}]}},{\"foods\":{}},{}]");
+  REQUIRE(node.find("0/foods/likes") == parseJson(json).find("0/foods/likes"));
+
+  // indexes stay valid
+  const Node second = parseJson(json, {"1/name", "2/foods"});
+  REQUIRE(formatJson(second) == "[null,{\"name\":\"b\"},{\"foods\":\"none\"}]");
+  REQUIRE(second.as<Array>()[0].isA<Undefined>());
+  REQUIRE(second.find("1/name") == Node("b"));
+  REQUIRE(second.find("2/foods") == Node("none"));
+
+  // matches can be deferred
+  ParseOptions options;
+  options.deferDepth = 1;
+  const Node deferred = parseJson(json, {"0/foods/likes", "2/name"}, options);
+  REQUIRE(deferred.find("0/foods/likes/1/y") == Node(Integer(1)));
+  REQUIRE(formatJson(deferred) == "[{\"foods\":{\"likes\":[\"x\",{\"y\":1}]}},null,{\"name\":\"c\"}]");
+
+  REQUIRE(formatJson(parseJson(json, {"x"})) == "[null,null,null]");
+  REQUIRE(parseJson(std::string("1"), {"a"}).isA<Undefined>());
+  REQUIRE_THROWS(parseJson(std::string("[1,}"), {"a"}));
+
+  // skipped parts are checked as well
+  for(std::string bad : {"{\"keep\":1,\"drop\":[1,2}}", "{\"keep\":1,\"drop\":[1 2 3 ,,,]}",
+                         "{\"keep\":1,\"drop\":{\"x\":tru}}", "{\"keep\":1,\"drop\":\"x}",
+                         "{\"keep\":1,\"drop\":{]}", "{\"keep\":1,\"drop\":[1e400]}"})
+  {
+    INFO(bad);
+    REQUIRE_THROWS(parseJson(bad, {"keep"}));
+  }
+  REQUIRE(formatJson(parseJson(std::string("{\"keep\":1,\"drop\":[\"]}\\\"\",{\"x\":[]}]}"), {"keep"})) ==
+          "{\"keep\":1}");
+}
+
+TEST_CASE("reusable parser", "[JsonParser]")
+{
+  Parser parser;
+  REQUIRE(parser.parse("{\"a\":[1,2,{\"b\":\"c\"}]}") == parseJson(std::string("{\"a\":[1,2,{\"b\":\"c\"}]}")));
+  REQUIRE(parser.parse("[true,null]") == parseJson(std::string("[true,null]")));
+  REQUIRE_THROWS(parser.parse("[1,"));
+  REQUIRE(parser.parse("\"x\"") == Node(String("x")));
+
+  // a partial document is dropped by reset()
+  parser.parseChunk("{\"a\":[1", 7);
+  parser.reset();
+  parser.parseChunk("[1,", 3);
+  parser.parseChunk("2]", 2);
+  REQUIRE(parser.finish() == parseJson(std::string("[1,2]")));
+
+  ParseOptions options;
+  options.dedupe = true;
+  parser.reset(options);
+  Node node = parser.parse("[[1,2],[1,2]]");
+  REQUIRE(node.as<Array>()[0].isShared());
+  REQUIRE(node.as<Array>()[1].isShared());
+  parser.reset(ParseOptions());
+  node = parser.parse("[[1,2],[1,2]]");
+  REQUIRE_FALSE(node.as<Array>()[0].isShared());
+
+  // the thread local parser of parseJson() takes the options of each call
+  REQUIRE(parseJson(std::string("[[1],[1]]"), options).as<Array>()[0].isShared());
+  REQUIRE_FALSE(parseJson(std::string("[[1],[1]]")).as<Array>()[0].isShared());
+
+  // the buffers of a huge document are not kept
+  std::string deep;
+  for(std::size_t i = 0; i < 5000; i++)
+  {
+    deep += "{\"" + std::string(i == 0 ? 100000 : 1, 'k') + "\":[";
+  }
+  deep += "1";
+  for(std::size_t i = 0; i < 5000; i++)
+  {
+    deep += "]}";
+  }
+  detail::Parser p;
+  p.parse("{\"a\":[1,2]}");
+  std::size_t small = p.retainedBytes();
+  p.reset();
+  p.parse(deep);
+  REQUIRE(p.retainedBytes() > 100000);
+  p.reset();
+  REQUIRE(p.retainedBytes() <= small);
+  p.parse("{\"a\":[1,2]}");
+  REQUIRE(formatJson(Node(p.takeValue())) == "{\"a\":[1,2]}");
+}
+
+TEST_CASE("parse into an existing node", "[JsonParser]")
+{
+  Node node;
+  parseInto(node, "{\"id\":1,\"name\":\"the first message of the stream\",\"tags\":[\"a\",\"b\",\"c\"],\"pos\":{\"x\":1,\"y\":2}}");
+  const Object * obj = &node.as<Object>();
+  const Array * tags = &node.as<Object>()["tags"].as<Array>();
+  const char * name = node.as<Object>()["name"].as<String>().data();
+
+  // same shape, the payloads and the string buffer are reused
+  std::string json("{\"id\":2,\"name\":\"the second message\",\"tags\":[\"d\",\"e\",\"f\"],\"pos\":{\"x\":3,\"y\":4}}");
+  parseInto(node, json);
+  REQUIRE(node == parseJson(json));
+  REQUIRE(&node.as<Object>() == obj);
+  REQUIRE(&node.as<Object>()["tags"].as<Array>() == tags);
+  REQUIRE(node.as<Object>()["name"].as<String>().data() == name);
+
+  // different shapes
+  json = "{\"id\":3,\"tags\":[\"g\"],\"name\":\"third\",\"pos\":[1],\"extra\":null}";
+  parseInto(node, json);
+  REQUIRE(node == parseJson(json));
+  REQUIRE(formatJson(node) == formatJson(parseJson(json)));
+  json = "{\"id\":4,\"tags\":[\"g\",\"h\",{\"i\":[]}],\"name\":5}";
+  parseInto(node, json);
+  REQUIRE(node == parseJson(json));
+  REQUIRE(node.as<Object>().size() == 3);
+  json = "[1,\"x\",[2]]";
+  parseInto(node, json);
+  REQUIRE(node == parseJson(json));
+  json = "{\"a\":1,\"a\":2}";
+  parseInto(node, json);
+  REQUIRE(node == parseJson(json));
+  parseInto(node, "\"s\"");
+  REQUIRE(node == Node(String("s")));
+
+  ParseOptions options;
+  options.hash = true;
+  json = "{\"id\":5,\"tags\":[\"g\",\"h\",{\"i\":[]}],\"name\":5}";
+  Node other = parseJson(json);
+  parseInto(other, "{\"id\":6,\"tags\":[\"g\",\"h\",{\"i\":[1]}],\"name\":5}", options);
+  REQUIRE(other.hash() == parseJson(std::string("{\"id\":6,\"tags\":[\"g\",\"h\",{\"i\":[1]}],\"name\":5}")).hash());
+
+  REQUIRE_THROWS(parseInto(node, "[1,"));
+  REQUIRE(node.isA<Null>());
+
+  Parser parser;
+  parser.parseInto(node, json);
+  REQUIRE(node == parseJson(json));
+}
+
+TEST_CASE("parse objects with repeated keys", "[JsonParser]")
+{
+  std::string json("[");
+  for(std::size_t i = 0; i < 50; i++)
+  {
+    json += (i ? "," : "");
+    json += "{\"bid\":" + std::to_string(i) + ",\"ask\":1.5,\"sym\":\"X\",\"q\":{\"a\":1,\"b\":2}}";
+  }
+  // keys that only partially match the previous ones
+  json += ",{\"bi\":1,\"askx\":2,\"sym\":3,\"q\":{\"b\":1}}";
+  json += ",{\"bid\":1,\"a\\u0073k\":2,\"s\\\"m\":3,\"q\":{}}";
+  json += ",{\"bid\":1,\"ask\":2,\"s\\\"m\":3,\"q\":{\"a\":1}}";
+  json += ",{\"bid\":1,\"ask\":2,\"s\\\"m\":3}]";
+  Node node = parseJson(json);
+  REQUIRE(node.as<Array>().size() == 54);
+  const Array & arr(node.as<Array>());
+  REQUIRE(formatJson(arr[49]) == "{\"bid\":49,\"ask\":1.5,\"sym\":\"X\",\"q\":{\"a\":1,\"b\":2}}");
+  REQUIRE(formatJson(arr[50]) == "{\"bi\":1,\"askx\":2,\"sym\":3,\"q\":{\"b\":1}}");
+  REQUIRE(formatJson(arr[51]) == "{\"bid\":1,\"ask\":2,\"s\\\"m\":3,\"q\":{}}");
+  REQUIRE(formatJson(arr[52]) == "{\"bid\":1,\"ask\":2,\"s\\\"m\":3,\"q\":{\"a\":1}}");
+  REQUIRE(formatJson(arr[53]) == "{\"bid\":1,\"ask\":2,\"s\\\"m\":3}");
+
+  // predictions across documents and chunks, positions stay exact
+  Parser parser;
+  std::string doc("{\"alpha\":1,\n\"beta\":2}");
+  for(std::size_t split = 0; split <= doc.size(); split++)
+  {
+    parser.parseChunk(doc.c_str(), split);
+    parser.parseChunk(doc.c_str() + split, doc.size() - split);
+    REQUIRE(formatJson(parser.finish()) == "{\"alpha\":1,\"beta\":2}");
+  }
+  detail::Parser p;
+  p.parseChunk(std::string("{\"alpha\":1}"));
+  p.flush();
+  p.reset();
+  p.parseChunk(std::string("{\"alpha\""));
+  REQUIRE(p.getPos() == std::make_tuple(std::size_t(0), std::size_t(8), detail::Parser::STRING_END));
+
+  // large objects are only learned partially
+  std::string large("{");
+  for(std::size_t i = 0; i < 1000; i++)
+  {
+    large += (i ? ",\"" : "\"") + std::string(i % 3 ? 3 : 300, 'k') + std::to_string(i) + "\":" + std::to_string(i);
+  }
+  large += "}";
+  detail::Parser learner;
+  for(std::size_t i = 0; i < 2; i++)
+  {
+    learner.reset();
+    learner.parse(large);
+    REQUIRE(formatJson(Node(learner.takeValue())) == large);
+  }
+  REQUIRE(learner.learnedKeys() == 64);
+
+  // prediction can be turned off without affecting the tree
+  ParseOptions unpredicted;
+  unpredicted.predictKeys = false;
+  detail::Parser plain(unpredicted);
+  plain.parse(json);
+  REQUIRE(Node(plain.takeValue()) == node);
+  REQUIRE(plain.learnedKeys() == 0);
+  StringPool pool;
+  unpredicted.strings = &pool;
+  REQUIRE(parseJson(json, unpredicted) == node);
+  REQUIRE(pool.keyCount() > 0);
+}
+
+TEST_CASE("parse with UTF-8 validation", "[JsonParser]")
+{
+  ParseOptions options;
+  options.validateUtf8 = true;
+  std::string valid("{\"k\\u00e9y \xc3\xa9\":[\"plain ascii text of some length\",\"\xe2\x82\xac \xf0\x9f\x98\x80 \xed\x9f\xbf\"]}");
+  REQUIRE(parseJson(valid, options) == parseJson(valid));
+  options.borrow = true;
+  REQUIRE(parseJson(valid, options) == parseJson(valid));
+
+  std::vector<std::pair<std::string, std::size_t>> invalid = {
+    {"\"abcdefghijklmnop\xff\"", 17},
+    {"\"\xc3\"", 2},
+    {"\"\xc0\xaf\"", 1},
+    {"\"\xe0\x80\xaf\"", 2},
+    {"\"\xed\xa0\x80\"", 2},
+    {"\"\xf4\x90\x80\x80\"", 2},
+    {"[\"ok\",{\"\xc3\\n\":1}]", 9},
+    {"\"\xc3\\u0041\"", 2}
+  };
+  for(auto & test : invalid)
+  {
+    INFO(test.first);
+    REQUIRE_NOTHROW(parseJson(test.first));
+    for(bool borrow : {false, true})
+    {
+      options.borrow = borrow;
+      std::string msg;
+      try
+      {
+        parseJson(test.first, options);
+      }
+      catch(const std::exception & e)
+      {
+        msg = e.what();
+      }
+      REQUIRE(msg == "invalid UTF-8 at offset " + std::to_string(test.second));
+    }
+  }
+
+  // sequences split between chunks
+  options.borrow = false;
+  std::string text("[\"\xe2\x82\xac\xf0\x9f\x98\x80\"]");
+  Parser parser(options);
+  for(std::size_t split = 0; split <= text.size(); split++)
+  {
+    parser.parseChunk(text.c_str(), split);
+    parser.parseChunk(text.c_str() + split, text.size() - split);
+    REQUIRE(parser.finish() == parseJson(text));
+  }
+}
+
+TEST_CASE("parse unicode escapes", "[JsonParser]")
+{
+  REQUIRE(parseJson(std::string("\"\\u0041\\u00e9\\u20AC\\ud83d\\ude00 \\ud834\\udd1e\"")).as<String>() ==
+          "A\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80 \xf0\x9d\x84\x9e");
+  REQUIRE(parseJson(std::string("{\"\\u006b\\u0065\\u0079\":\"\\t\\\"\\u4e2d\\u6587\\n\"}")) ==
+          parseJson(std::string("{\"key\":\"\\t\\\"\xe4\xb8\xad\xe6\x96\x87\\n\"}")));
+  for(std::string json : {"\"\\ud800\"", "\"\\ud800x\"", "\"\\ud800\\n\"", "\"\\ud800\\u0041\"",
+                          "\"\\udc00\"", "\"\\u12g4\"", "\"\\u12\""})
+  {
+    INFO(json);
+    REQUIRE_THROWS(parseJson(json));
+  }
+
+  // escapes split between chunks decode like the bulk path
+  std::string text("[\"a\\u4e2d\\ud83d\\ude00\\n\\u0041b\"]");
+  Node expected = parseJson(text);
+  REQUIRE(expected.as<Array>()[0].as<String>() == "a\xe4\xb8\xad\xf0\x9f\x98\x80\nAb");
+  Parser parser;
+  std::size_t mismatch = 0;
+  for(std::size_t split = 0; split <= text.size(); split++)
+  {
+    parser.parseChunk(text.c_str(), split);
+    parser.parseChunk(text.c_str() + split, text.size() - split);
+    mismatch += (parser.finish() == expected ? 0 : 1);
+  }
+  REQUIRE(mismatch == 0);
+  std::string::const_iterator begin = text.begin();
+  REQUIRE(parseJson(begin, text.cend()) == expected);
+}
+
+TEST_CASE("position is derived from the consumed input", "[JsonParser]")
+{
+  std::string text("{\"key\": \"va\\u00e9lue\",\r\n  \"list\": [1, 2.5,\n\n true]\r\n}");
+  std::size_t mismatch = 0;
+  for(std::size_t split = 0; split <= text.size(); split++)
+  {
+    std::size_t line = 0;
+    std::size_t col = 0;
+    for(std::size_t i = 0; i < split; i++)
+    {
+      if(text[i] == '\n')
+      {
+        line++;
+        col = 0;
+      }
+      else if(text[i] != '\r')
+      {
+        col++;
+      }
+    }
+    detail::Parser p;
+    p.parseChunk(text.c_str(), split);
+    mismatch += (p.getLine() == line && p.getCol() == col ? 0 : 1);
+    p.parseChunk(text.c_str() + split, text.size() - split);
+    mismatch += (p.getLine() == 4 && p.getCol() == 1 ? 0 : 1);
+  }
+  REQUIRE(mismatch == 0);
+
+  // the offending character
+  detail::Parser p;
+  p.parseChunk(std::string("[1,\n  2,\r\n"));
+  REQUIRE_THROWS(p.parseChunk(std::string("  tru e]")));
+  REQUIRE(p.getLine() == 2);
+  REQUIRE(p.getCol() == 6);
+  REQUIRE(p.getOffset() == 15);
+}
@@ -165,10 +165,10 @@ TEST_CASE("parse_string", "[JsonParser]")
       {"\"\\t\"", "\t"},
       {"\" \\\\ \"", " \\ "},
       {"\" \\\" \"", " \" "},
-      {"\" \\n \\r \\t \\\" \\\\ \"", " \n \r \t \" \\ "}
+      {"\" \\n \\r \\t \\\" \\\\ \"", " \n \r \t \" \\ "},
+      {"\"\\u0141 \\u0143\"", "\u0141 \u0143"},
+      {"\"\\ud83d\\ude00\"", "\xf0\x9f\x98\x80"}
     });
-  //@todo: implement unicode support
-  //{"\"\\u0141 \\u0143\"", "\"\u0141 \u0143\""}
   for(const auto & c : cases)
   {
     Parser p;
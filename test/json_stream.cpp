@@ -0,0 +1,428 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <catch2/catch.hpp>
+#include <surfsara/ast.h>
+#include <surfsara/json_parser.h>
+#include <surfsara/json_format.h>
+#include <surfsara/json_stream.h>
+#include <sstream>
+
+using namespace surfsara::ast;
+
+TEST_CASE("stream find", "[JsonStream]")
+{
+  std::string json =
+    "{\"meta\":{\"n\":3},\"records\":["
+    "{\"id\":1,\"tags\":[\"a\",\"b\"]},"
+    "{\"id\":2,\"tags\":[]},"
+    "{\"id\":3,\"tags\":[\"c\"],\"x\":{\"id\":4}}]}";
+  std::vector<Node> nodes;
+  std::vector<std::string> paths;
+  auto collect = [&nodes, &paths](const Node & node, const std::vector<std::string> & path){
+    nodes.push_back(node);
+    paths.push_back(path[0] + "/" + path[1] + "/" + path[2]);
+    return true;
+  };
+  std::stringstream ss(json);
+  REQUIRE(streamFind(ss, "records/*/id", collect) == 3u);
+  REQUIRE(nodes == std::vector<Node>({Integer(1), Integer(2), Integer(3)}));
+  REQUIRE(paths == std::vector<std::string>({"records/0/id", "records/1/id", "records/2/id"}));
+
+  // containers are materialized
+  nodes.clear();
+  paths.clear();
+  REQUIRE(streamFind(json.c_str(), json.size(), "records/*/tags", collect) == 3u);
+  REQUIRE(formatJson(nodes[0]) == "[\"a\",\"b\"]");
+  REQUIRE(formatJson(nodes[2]) == "[\"c\"]");
+  REQUIRE(paths[2] == "records/2/tags");
+}
+
+TEST_CASE("stream find stops early", "[JsonStream]")
+{
+  // the input after the first match is never read
+  std::stringstream ss("[{\"a\":1},{\"a\":2},{\"a\":3}] trailing garbage");
+  std::vector<Node> nodes;
+  REQUIRE(streamFind(ss, "*/a", [&nodes](const Node & node, const std::vector<std::string> &){
+        nodes.push_back(node);
+        return nodes.size() < 2u;
+      }) == 2u);
+  REQUIRE(nodes == std::vector<Node>({Integer(1), Integer(2)}));
+
+  std::string json("[1,2,");
+  REQUIRE_THROWS(streamFind(json.c_str(), json.size(), "*",
+                            [](const Node &, const std::vector<std::string> &){ return true; }));
+}
+
+TEST_CASE("stream find across chunks", "[JsonStream]")
+{
+  std::string json("[");
+  for(int i = 0; i < 20000; i++)
+  {
+    json += (i ? "," : "");
+    json += "{\"key\":\"value " + std::to_string(i) + "\",\"skip\":[1,2,{\"a\":\"]\"}]}";
+  }
+  json += "]";
+  std::stringstream ss(json);
+  std::size_t found = 0;
+  REQUIRE(streamFind(ss, "*/key", [&found](const Node & node, const std::vector<std::string> & path){
+        if(node.as<String>() == "value " + path[0])
+        {
+          found++;
+        }
+        return true;
+      }) == 20000u);
+  REQUIRE(found == 20000u);
+}
+
+TEST_CASE("array reader", "[JsonStream]")
+{
+  std::string json = " [ {\"id\":1,\"v\":[1,2]}, \"two\" ,3.5,[],{\"id\":\"]\"} ] ";
+  const Node all = parseJson(json);
+  std::vector<Node> expected(all.as<Array>().begin(), all.as<Array>().end());
+  {
+    std::stringstream ss(json);
+    ArrayReader reader(ss);
+    std::vector<Node> nodes;
+    for(Node & node : reader)
+    {
+      nodes.push_back(std::move(node));
+    }
+    REQUIRE(nodes == expected);
+  }
+  {
+    ParseOptions options;
+    options.borrow = true;
+    ArrayReader reader(json.c_str(), json.size(), options);
+    Node node;
+    std::size_t i = 0;
+    while(reader.next(node))
+    {
+      REQUIRE(node == expected[i++]);
+    }
+    REQUIRE(i == expected.size());
+    REQUIRE_FALSE(reader.next(node));
+  }
+  std::stringstream empty("[]");
+  ArrayReader emptyReader(empty);
+  REQUIRE(emptyReader.begin() == emptyReader.end());
+
+  std::stringstream object("{\"a\":1}");
+  ArrayReader objectReader(object);
+  REQUIRE_THROWS(objectReader.begin());
+
+  std::string truncated("[1,2");
+  ArrayReader truncatedReader(truncated.c_str(), truncated.size());
+  Node node;
+  REQUIRE(truncatedReader.next(node));
+  REQUIRE_THROWS(truncatedReader.next(node));
+}
+
+TEST_CASE("array reader across chunks", "[JsonStream]")
+{
+  std::string json("[");
+  for(int i = 0; i < 20000; i++)
+  {
+    json += (i ? "," : "");
+    json += "{\"key\":\"value " + std::to_string(i) + "\"}";
+  }
+  json += "]";
+  std::stringstream ss(json);
+  ArrayReader reader(ss);
+  std::size_t i = 0;
+  std::size_t matches = 0;
+  for(const Node & node : reader)
+  {
+    if(node.find("key") == Node("value " + std::to_string(i++)))
+    {
+      matches++;
+    }
+  }
+  REQUIRE(matches == 20000u);
+}
+
+TEST_CASE("rewriter matches update and remove", "[JsonStream]")
+{
+  std::string json =
+    "{ \"name\" : \"x\", \"users\" : [ {\"id\":1, \"pw\":\"a\", \"tags\":[1,2]},"
+    " {\"id\":2, \"pw\":\"b\", \"tags\":[]} ], \"meta\": {\"v\": 1}, \"list\": [1, 2, 3] }";
+  JsonRewriter rewriter;
+  rewriter.remove("users/*/pw")
+    .update("users/*/id", Node(Integer(0)))
+    .update("meta/created", Node("today"), true)
+    .update("meta/v", Node(Array{Integer(2)}))
+    .update("users/0/tags/#", Node(Integer(3)), true)
+    .update("users/*/new", Node(true), true)
+    .remove("list/1");
+  Node expected = parseJson(json);
+  expected.remove("users/*/pw");
+  expected.update("users/*/id", Node(Integer(0)));
+  expected.update("meta/created", Node("today"), true);
+  expected.update("meta/v", Node(Array{Integer(2)}));
+  expected.update("users/0/tags/#", Node(Integer(3)), true);
+  expected.update("users/*/new", Node(true), true);
+  expected.remove("list/1");
+  REQUIRE(rewriter.rewrite(json) == formatJson(expected));
+
+  // no rules gives compact output
+  REQUIRE(JsonRewriter().rewrite(json) == formatJson(parseJson(json)));
+  REQUIRE(JsonRewriter().rewrite(" \"a\\\"b\" ") == "\"a\\\"b\"");
+  REQUIRE(JsonRewriter().rewrite("12") == "12");
+}
+
+TEST_CASE("rewriter inserts missing paths", "[JsonStream]")
+{
+  std::string json = "{\"a\":{},\"b\":[]}";
+  JsonRewriter rewriter;
+  rewriter.update("a/x/y", Node(Integer(1)), true)
+    .update("b/#/z", Node(Integer(2)), true)
+    .update("c", Node("new"), true)
+    .update("d", Node("ignored"), false);
+  Node expected = parseJson(json);
+  expected.update("a/x/y", Node(Integer(1)), true);
+  expected.update("b/#/z", Node(Integer(2)), true);
+  expected.update("c", Node("new"), true);
+  expected.update("d", Node("ignored"), false);
+  REQUIRE(rewriter.rewrite(json) == formatJson(expected));
+  REQUIRE(rewriter.rewrite(json) == "{\"a\":{\"x\":{\"y\":1}},\"b\":[{\"z\":2}],\"c\":\"new\"}");
+}
+
+TEST_CASE("rewriter streams", "[JsonStream]")
+{
+  std::string json("[");
+  for(int i = 0; i < 20000; i++)
+  {
+    json += (i ? "," : "");
+    json += "{\"secret\":\"" + std::to_string(i) + "\",\"keep\":[\"{\\\"\",{\"secret\":1}]}";
+  }
+  json += "]";
+  JsonRewriter rewriter;
+  rewriter.update("*/secret", Node("***"));
+  std::stringstream in(json);
+  std::stringstream out;
+  rewriter.rewrite(in, out);
+  Node expected = parseJson(json);
+  expected.update("*/secret", Node("***"));
+  REQUIRE(out.str() == formatJson(expected));
+
+  REQUIRE_THROWS(rewriter.rewrite("[1,2"));
+  REQUIRE_THROWS(rewriter.rewrite("{\"a\" 1}"));
+  REQUIRE_THROWS(rewriter.rewrite("[1,]"));
+  REQUIRE_THROWS(rewriter.rewrite("[1] x"));
+}
+
+TEST_CASE("rewriter checks the values it copies", "[JsonStream]")
+{
+  // rules that fit the root, so that only the syntax is wrong
+  JsonRewriter objects;
+  objects.remove("a");
+  JsonRewriter arrays;
+  arrays.remove("0");
+  std::vector<std::string> invalid({"[1 2]", "[1,}", "{\"a\":tru}", "[abc]", "{\"a\":{]}",
+                                    "{\"b\":[1 2]}", "{\"a\":[1 2]}", "{\"a\":\"x}",
+                                    "{\"a\":01x}", "[\"\\u12\"]", "1 2"});
+  std::size_t failed = 0;
+  for(const std::string & json : invalid)
+  {
+    bool parserFails = false;
+    try
+    {
+      parseJson(json);
+    }
+    catch(...)
+    {
+      parserFails = true;
+    }
+    bool rewriterFails = false;
+    try
+    {
+      (json[0] == '{' ? objects : json[0] == '[' ? arrays : JsonRewriter()).rewrite(json);
+    }
+    catch(const std::runtime_error &)
+    {
+      rewriterFails = true;
+    }
+    failed += (parserFails && rewriterFails);
+  }
+  REQUIRE(failed == invalid.size());
+
+  // escapes the parser drops are dropped from the output, the
+  // other tokens are copied as they are
+  std::string json = "{\"k\\q\":\"a\\qb\\n\", \"l\" : [ \"\\u00e9\" , 1.5e3 ]}";
+  REQUIRE(JsonRewriter().rewrite(json) == "{\"k\":\"ab\\n\",\"l\":[\"\\u00e9\",1.5e3]}");
+}
+
+TEST_CASE("rewriter applies later rules to replaced values", "[JsonStream]")
+{
+  std::string json = "{\"a\":1,\"b\":{\"x\":1},\"c\":[1,2]}";
+  std::vector<JsonRewriter::Rule> rules({
+      {{"a"}, false, Node(Object{Pair{"y", Integer(1)}}), true},
+      {{"a", "y"}, false, Node(Integer(2)), true},
+      {{"b"}, true, Node(), false},
+      {{"b"}, false, Node(Integer(5)), true},
+      {{"c", "0"}, false, Node(Integer(7)), true},
+      {{"c"}, false, Node(Array{}), true},
+      {{"c", "#"}, false, Node(Integer(3)), true},
+      {{"d", "x"}, false, Node(Integer(1)), true},
+      {{"d", "y"}, false, Node(Integer(2)), true},
+      {{"d", "x"}, true, Node(), false}});
+  JsonRewriter rewriter;
+  Node expected = parseJson(json);
+  for(const JsonRewriter::Rule & rule : rules)
+  {
+    std::string path;
+    for(const std::string & segment : rule.path)
+    {
+      path += (path.empty() ? "" : "/") + segment;
+    }
+    if(rule.remove)
+    {
+      rewriter.remove(path);
+      expected.remove(path);
+    }
+    else
+    {
+      rewriter.update(path, rule.value, rule.insert);
+      expected.update(path, rule.value, rule.insert);
+    }
+  }
+  REQUIRE(rewriter.rewrite(json) == formatJson(expected));
+  REQUIRE(rewriter.rewrite(json) == "{\"a\":{\"y\":2},\"c\":[3],\"b\":5,\"d\":{\"y\":2}}");
+
+  REQUIRE(JsonRewriter().update("a", Node(Object{Pair{"y", Integer(1)}}))
+          .update("a/y", Node(Integer(2))).rewrite("{\"a\":0}") == "{\"a\":{\"y\":2}}");
+  REQUIRE(JsonRewriter().remove("a").update("a", Node(Integer(5)), true)
+          .rewrite("{\"a\":0}") == "{\"a\":5}");
+  REQUIRE(JsonRewriter().remove("a").update("a", Node(Integer(5)), false)
+          .rewrite("{\"a\":0}") == "{}");
+}
+
+TEST_CASE("rewriter shifts array indexes like the tree", "[JsonStream]")
+{
+  struct Step
+  {
+    std::string path;
+    bool remove;
+    Integer value;
+  };
+  std::string json = "{\"a\":[1,2,3,{\"x\":4}],\"b\":5}";
+  std::vector<std::vector<Step>> cases({
+      {{"a/0", true, 0}, {"a/0", true, 0}},
+      {{"a/1", true, 0}, {"a/1", false, 9}, {"a/0", true, 0}},
+      {{"a/2/x", false, 7}, {"a/0", true, 0}, {"a/1/x", false, 8}},
+      {{"a/#", false, 6}, {"a/4", false, 7}, {"a/#", false, 8}},
+      {{"a/#", false, 6}, {"a/0", true, 0}, {"a/3", true, 0}, {"a/*", false, 1}},
+      {{"a/*", true, 0}, {"a/#", false, 2}, {"a/0", false, 3}},
+      {{"a/3", true, 0}, {"a/3", false, 0}},
+      {{"a/5", false, 0}},
+      {{"a/9/x", false, 0}},
+      {{"a/9", true, 0}, {"a/9/x", true, 0}},
+      {{"a/x", false, 0}},
+      {{"b/x", false, 0}},
+      {{"b/x", true, 0}},
+      {{"*/x", false, 0}}});
+  for(const std::vector<Step> & steps : cases)
+  {
+    JsonRewriter rewriter;
+    Node expected = parseJson(json);
+    std::string dom;
+    for(const Step & step : steps)
+    {
+      INFO(step.path);
+      if(step.remove)
+      {
+        rewriter.remove(step.path);
+      }
+      else
+      {
+        rewriter.update(step.path, Node(step.value));
+      }
+      try
+      {
+        if(step.remove)
+        {
+          expected.remove(step.path);
+        }
+        else
+        {
+          expected.update(step.path, Node(step.value));
+        }
+      }
+      catch(const PathError &)
+      {
+        dom = "PathError";
+      }
+    }
+    std::string rewritten;
+    try
+    {
+      rewritten = rewriter.rewrite(json);
+    }
+    catch(const PathError &)
+    {
+      rewritten = "PathError";
+    }
+    INFO(steps[0].path);
+    REQUIRE(rewritten == (dom.empty() ? formatJson(expected) : dom));
+  }
+}
+
+namespace
+{
+  class WriteCounter : public std::streambuf
+  {
+  public:
+    std::size_t writes = 0;
+    std::size_t size = 0;
+
+  protected:
+    std::streamsize xsputn(const char * s, std::streamsize n) override
+    {
+      writes++;
+      size += std::size_t(n);
+      return n;
+    }
+
+    int overflow(int ch) override
+    {
+      writes++;
+      size++;
+      return ch;
+    }
+  };
+}
+
+TEST_CASE("rewriter writes large buffers in chunks", "[JsonStream]")
+{
+  std::string json("[");
+  for(int i = 0; i < 100000; i++)
+  {
+    json += (i ? ",\"" : "\"") + std::to_string(i) + "\"";
+  }
+  json += "]";
+  WriteCounter counter;
+  std::ostream ost(&counter);
+  JsonRewriter().rewrite(json.c_str(), json.size(), ost);
+  REQUIRE(counter.size == json.size());
+  REQUIRE(counter.writes > 1u);
+}
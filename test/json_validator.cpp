@@ -0,0 +1,171 @@
+/*
+MIT License
+
+Copyright (c) 2018 SURFsara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <catch2/catch.hpp>
+#include <surfsara/ast.h>
+#include <surfsara/json_parser.h>
+#include <surfsara/json_validator.h>
+
+using namespace surfsara::ast;
+
+TEST_CASE("validate json", "[JsonValidator]")
+{
+  std::vector<std::string> valid = {
+    "0", "-0", "1.5e+3", "-12.25E-2", "true", "false", "null", " \"\" ",
+    "\"abc\\n\\\"\\\\\\/\\u00e9\\ud83d\\ude00 some longer text\"",
+    "[]", "{}", "[1,[2,[3]],{\"a\":{\"b\":[]}}]", " { \"k\" : \"v\" , \"l\" : [ true , null ] } ",
+    // accepted by the parser as well
+    "01", "+1", "1.", ".5", "-.5", "1.e5", "[1e+]", "\"a\\xb\"", "\"a\tb\"", "\v1\f",
+    "9223372036854775807", "1e-400", std::string("[1]\0", 4)
+  };
+  for(const std::string & json : valid)
+  {
+    INFO(json);
+    REQUIRE(validateJson(json).valid);
+    REQUIRE_NOTHROW(parseJson(json));
+  }
+
+  struct Invalid
+  {
+    std::string json;
+    std::size_t offset;
+  };
+  std::vector<Invalid> invalid = {
+    {"", 0}, {"[1,2", 4}, {"[1,]", 3}, {"[,1]", 1}, {"{\"a\" 1}", 5},
+    {"{1:2}", 1}, {"{\"a\":1,}", 7}, {"[1}", 2}, {".", 1}, {"[-]", 2},
+    {"-", 1}, {"1e", 2}, {"+", 1}, {"tru", 3}, {"trux", 3}, {"[1 2]", 3},
+    {"\"abc", 4}, {"\"\\u12g4\"", 5}, {"\"\\ud800\"", 7},
+    {"\"\\udc00\"", 3}, {"{} {}", 3}, {"1e400", 5}, {"99999999999999999999999", 23},
+    {"-9223372036854775808", 20}, {"1e-5000", 7}, {std::string("[1\0]", 4), 2}
+  };
+  for(const Invalid & test : invalid)
+  {
+    INFO(test.json);
+    ValidationResult res = validateJson(test.json);
+    REQUIRE_FALSE(res.valid);
+    REQUIRE(res.offset == test.offset);
+    REQUIRE(res.message != nullptr);
+    REQUIRE_THROWS(parseJson(test.json));
+  }
+
+  REQUIRE(validateJson("\"\\ud83d\\ude00\"").valid);
+
+  // no limit on the nesting
+  std::string deep = std::string(10000, '[') + std::string(5000, ']') + "{}" + std::string(5000, ']');
+  REQUIRE_FALSE(validateJson(deep).valid);
+  REQUIRE(validateJson(deep).offset == 15000);
+  deep = std::string(10000, '[') + std::string(10000, ']');
+  REQUIRE(validateJson(deep).valid);
+}
+
+TEST_CASE("validate json in chunks", "[JsonValidator]")
+{
+  std::string json("{\"name\":\"a string that spans several chunks \\u00e9\\ud83d\\ude00\","
+                   "\"n\":[-12.5e+10,0,true,false,null,{}],\"x\":\"\\\"\"}");
+  JsonValidator validator;
+  std::size_t failures = 0;
+  for(std::size_t size = 1; size <= json.size(); size++)
+  {
+    validator.reset();
+    for(std::size_t i = 0; i < json.size(); i += size)
+    {
+      validator.feed(json.c_str() + i, std::min(size, json.size() - i));
+    }
+    failures += (validator.finish().valid ? 0 : 1);
+  }
+  REQUIRE(failures == 0);
+  std::string broken(json);
+  std::size_t pos = json.find("e+10") + 1;
+  broken[pos] = 'x';
+  validator.reset();
+  REQUIRE(validator.feed(broken.c_str(), 30));
+  REQUIRE_FALSE(validator.feed(broken.c_str() + 30, broken.size() - 30));
+  ValidationResult res = validator.finish();
+  REQUIRE_FALSE(res.valid);
+  REQUIRE(res.offset == pos);
+}
+
+TEST_CASE("validator agrees with the parser", "[JsonValidator]")
+{
+  std::vector<std::string> corpus = {
+    "{\"name\":\"text \\u00e9\\ud83d\\ude00\\n\",\"n\":[-12.5e+10,0,1.,.5,+3,01],\"ok\":true}",
+    "[null, false, {\"a\" : [1e5, -0.0, \"\\\\\"]}, [], {}]",
+    " {\"k\":\"v\"}\n",
+    "[9223372036854775807,1.7976931348623157e308,1e-400]",
+    "\"a\\tb\\x\"",
+    "[[[{\"deep\":[[1]]}]]]"
+  };
+  const char alphabet[] = "{}[]\":,.-+eE0159tfnul\\ \t\n\v\x01x";
+  std::uint32_t seed = 12345;
+  auto random = [&seed](std::size_t n) -> std::size_t
+  {
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 8) % n;
+  };
+  std::vector<std::string> disagree;
+  std::size_t checked = 0;
+  for(const std::string & doc : corpus)
+  {
+    for(std::size_t k = 0; k < 2000; k++)
+    {
+      std::string json(doc);
+      for(std::size_t edits = 1 + random(3); edits > 0; edits--)
+      {
+        std::size_t pos = random(json.size() + 1);
+        char ch = alphabet[random(sizeof(alphabet) - 1)];
+        switch(random(3))
+        {
+        case 0:
+          if(pos < json.size()) json[pos] = ch;
+          break;
+        case 1:
+          json.insert(pos, 1, ch);
+          break;
+        default:
+          if(pos < json.size()) json.erase(pos, 1);
+        }
+      }
+      bool parsed = true;
+      try
+      {
+        parseJson(json);
+      }
+      catch(const std::exception &)
+      {
+        parsed = false;
+      }
+      JsonValidator validator;
+      std::size_t split = random(json.size() + 1);
+      validator.feed(json.c_str(), split);
+      validator.feed(json.c_str() + split, json.size() - split);
+      if(validateJson(json).valid != parsed || validator.finish().valid != parsed)
+      {
+        disagree.push_back(json);
+      }
+      checked += (parsed ? 1 : 0);
+    }
+  }
+  REQUIRE(disagree == std::vector<std::string>());
+  // the mutations keep some documents valid
+  REQUIRE(checked > 1000);
+}